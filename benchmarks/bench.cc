@@ -0,0 +1,500 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <args.h>
+#include <corpus.h>
+#include <densematrix.h>
+#include <dictionary.h>
+#include <eventlog.h>
+#include <fasttext.h>
+#include <loss.h>
+#include <model.h>
+#include <productquantizer.h>
+#include <utils.h>
+#include <vector.h>
+
+using namespace fasttext;
+
+namespace {
+
+constexpr int32_t kSeed = 1234;
+constexpr int32_t kDim = 100;
+
+struct Options {
+  std::string filter;
+  std::string output;
+  std::string dir;
+  double minTime;
+  int32_t repeats;
+  int64_t size;
+  int32_t words;
+  int32_t labels;
+  int32_t thread;
+
+  Options()
+      : minTime(0.2),
+        repeats(5),
+        size(4 << 20),
+        words(100000),
+        labels(200),
+        thread(std::max(1u, std::thread::hardware_concurrency())) {
+    const char* tmp = std::getenv("TMPDIR");
+    dir = tmp ? tmp : "/tmp";
+  }
+};
+
+// Times benchmarks and writes one JSON line per benchmark.
+class Runner {
+ protected:
+  Options options_;
+  EventLog& log_;
+
+  static double time(const std::function<void(int64_t)>& body, int64_t n) {
+    auto start = std::chrono::steady_clock::now();
+    body(n);
+    return utils::getDuration(start, std::chrono::steady_clock::now());
+  }
+
+ public:
+  Runner(const Options& options, EventLog& log)
+      : options_(options), log_(log) {}
+
+  bool enabled(const std::string& name) const {
+    return name.find(options_.filter) != std::string::npos;
+  }
+
+  // Runs body(n), which does n operations, doubling n until a run lasts
+  // -minTime, then -repeats runs of that size. The median run is reported,
+  // the fastest one being less noisy but hiding contention.
+  void run(
+      const std::string& name,
+      const std::function<void(int64_t)>& body,
+      int64_t itemsPerOp = 1) {
+    if (!enabled(name)) {
+      return;
+    }
+    int64_t n = 1;
+    while (time(body, n) < options_.minTime && n < (int64_t(1) << 40)) {
+      n *= 2;
+    }
+    std::vector<double> seconds;
+    for (int32_t i = 0; i < options_.repeats; i++) {
+      seconds.push_back(time(body, n));
+    }
+    std::sort(seconds.begin(), seconds.end());
+    double median = seconds[seconds.size() / 2];
+    log_.write(Event("benchmark")
+                   .add("name", name)
+                   .add("iterations", n)
+                   .add("repeats", options_.repeats)
+                   .add("nsPerOp", median * 1e9 / n)
+                   .add("minNsPerOp", seconds[0] * 1e9 / n)
+                   .add("itemsPerSecond", itemsPerOp * n / median));
+  }
+
+  // Reports a single run of `items` items, for end-to-end benchmarks.
+  void record(const std::string& name, double seconds, int64_t items) {
+    if (!enabled(name)) {
+      return;
+    }
+    log_.write(Event("benchmark")
+                   .add("name", name)
+                   .add("iterations", int64_t(1))
+                   .add("repeats", int32_t(1))
+                   .add("seconds", seconds)
+                   .add("itemsPerSecond", seconds > 0 ? items / seconds : 0.0));
+  }
+};
+
+CorpusOptions getCorpusOptions(const Options& options) {
+  CorpusOptions corpus;
+  corpus.words = options.words;
+  corpus.labels = options.labels;
+  corpus.seed = kSeed;
+  return corpus;
+}
+
+// Writes `lines` lines, or `bytes` bytes if lines is 0, of the corpus.
+void writeCorpus(
+    const std::string& path,
+    const CorpusOptions& options,
+    int64_t lines,
+    int64_t bytes) {
+  std::ofstream out(path);
+  CorpusGenerator(options).write(out, lines, bytes);
+  if (!out) {
+    throw std::runtime_error(path + " cannot be written!");
+  }
+}
+
+std::shared_ptr<DenseMatrix> randomMatrix(int64_t m, int64_t n) {
+  auto matrix = std::make_shared<DenseMatrix>(m, n);
+  matrix->uniform(1.0 / n, 1, kSeed);
+  return matrix;
+}
+
+std::vector<int32_t> randomIndices(int64_t size, int32_t max) {
+  std::minstd_rand rng(kSeed);
+  std::uniform_int_distribution<int32_t> uniform(0, max - 1);
+  std::vector<int32_t> indices(size);
+  for (auto& index : indices) {
+    index = uniform(rng);
+  }
+  return indices;
+}
+
+volatile real sink;
+
+void benchMatrix(Runner& runner) {
+  const int32_t rows = 100000;
+  auto matrix = randomMatrix(rows, kDim);
+  auto indices = randomIndices(1 << 16, rows);
+  Vector vec(kDim);
+  vec.zero();
+  vec[0] = 1.0;
+  runner.run(
+      "matrix/dotRow",
+      [&](int64_t n) {
+        real sum = 0.0;
+        for (int64_t i = 0; i < n; i++) {
+          sum += matrix->dotRow(vec, indices[i & 0xffff]);
+        }
+        sink = sum;
+      },
+      kDim);
+  runner.run(
+      "matrix/addVectorToRow",
+      [&](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+          matrix->addVectorToRow(vec, indices[i & 0xffff], 1e-6);
+        }
+      },
+      kDim);
+}
+
+void benchProductQuantizer(Runner& runner) {
+  if (!runner.enabled("pq/")) {
+    return;
+  }
+  // k-means on more rows takes long without changing mulcode
+  const int32_t rows = 4096;
+  auto matrix = randomMatrix(rows, kDim);
+  ProductQuantizer pq(kDim, 2);
+  pq.train(rows, matrix->data());
+  std::vector<uint8_t> codes(int64_t(rows) * (kDim / 2));
+  pq.compute_codes(matrix->data(), codes.data(), rows);
+  auto indices = randomIndices(1 << 16, rows);
+  Vector vec(kDim);
+  vec.zero();
+  vec[0] = 1.0;
+  runner.run(
+      "pq/mulcode",
+      [&](int64_t n) {
+        real sum = 0.0;
+        for (int64_t i = 0; i < n; i++) {
+          sum += pq.mulcode(vec, codes.data(), indices[i & 0xffff], 1.0);
+        }
+        sink = sum;
+      },
+      kDim);
+}
+
+void benchCorpus(Runner& runner, const Options& options) {
+  CorpusGenerator generator(getCorpusOptions(options));
+  int64_t bytes = 0;
+  const int32_t lines = 1000;
+  for (int32_t i = 0; i < lines; i++) {
+    bytes += generator.nextLine().size();
+  }
+  runner.run(
+      "corpus/generate",
+      [&](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+          generator.nextLine();
+        }
+      },
+      bytes / lines);
+}
+
+void benchDictionary(Runner& runner, const Options& options) {
+  if (!runner.enabled("dictionary/")) {
+    return;
+  }
+  std::ostringstream out;
+  CorpusGenerator(getCorpusOptions(options))
+      .write(out, 0, std::min(options.size, int64_t(4 << 20)));
+  const std::string corpus = out.str();
+  auto args = std::make_shared<Args>();
+  args->minn = 3;
+  args->maxn = 6;
+  args->wordNgrams = 2;
+  args->verbose = 0;
+  Dictionary dict(args);
+  std::istringstream in(corpus);
+  dict.readFromFile(in);
+  in.clear();
+  in.seekg(0);
+  std::vector<int32_t> words, labels;
+  int64_t tokens = 0;
+  int64_t lines = 0;
+  while (in.peek() != std::char_traits<char>::eof()) {
+    tokens += dict.getLine(in, words, labels);
+    lines++;
+  }
+  in.clear();
+  in.seekg(0);
+  runner.run(
+      "dictionary/getLine",
+      [&](int64_t n) {
+        for (int64_t i = 0; i < n; i++) {
+          // getLine rewinds the stream at its end
+          dict.getLine(in, words, labels);
+        }
+      },
+      tokens / lines);
+  std::vector<std::string> vocabulary;
+  for (int32_t i = 0; i < dict.nwords(); i++) {
+    vocabulary.push_back(dict.getWord(i));
+  }
+  std::vector<int32_t> ngrams;
+  runner.run("dictionary/computeSubwords", [&](int64_t n) {
+    for (int64_t i = 0; i < n; i++) {
+      ngrams.clear();
+      dict.computeSubwords(
+          Dictionary::BOW + vocabulary[i % vocabulary.size()] +
+              Dictionary::EOW,
+          ngrams);
+    }
+  });
+}
+
+void benchLosses(Runner& runner) {
+  if (!runner.enabled("loss/") && !runner.enabled("model/")) {
+    return;
+  }
+  const int32_t labels = 1000;
+  const int32_t words = 50000;
+  std::shared_ptr<Matrix> wi = randomMatrix(words, kDim);
+  std::shared_ptr<Matrix> wo = randomMatrix(labels, kDim);
+  std::vector<int64_t> counts(labels);
+  std::minstd_rand rng(kSeed);
+  for (auto& count : counts) {
+    count = 1 + rng() % 1000;
+  }
+  std::vector<std::pair<std::string, std::shared_ptr<Loss>>> losses = {
+      {"softmax", std::make_shared<SoftmaxLoss>(wo)},
+      {"ns", std::make_shared<NegativeSamplingLoss>(wo, 5, counts)},
+      {"hs", std::make_shared<HierarchicalSoftmaxLoss>(wo, counts)},
+      {"ova", std::make_shared<OneVsAllLoss>(wo)}};
+  auto targets = randomIndices(1 << 16, labels);
+  auto inputs = randomIndices(1 << 16, words);
+  for (const auto& loss : losses) {
+    Model::State state(kDim, labels, kSeed);
+    for (int32_t i = 0; i < kDim; i++) {
+      state.hidden[i] = 0.01 * (i % 7);
+    }
+    std::vector<int32_t> target(1);
+    runner.run("loss/forward/" + loss.first, [&](int64_t n) {
+      real sum = 0.0;
+      for (int64_t i = 0; i < n; i++) {
+        target[0] = targets[i & 0xffff];
+        // a lr of 0 keeps the output matrix unchanged between runs
+        sum += loss.second->forward(target, 0, state, 0.0, true);
+      }
+      sink = sum;
+    });
+    if (loss.first == "ns") {
+      continue; // predicts like ova
+    }
+    Model model(wi, wo, loss.second, true);
+    std::vector<int32_t> input(20);
+    Predictions heap;
+    runner.run("model/predict/" + loss.first, [&](int64_t n) {
+      for (int64_t i = 0; i < n; i++) {
+        for (int32_t j = 0; j < input.size(); j++) {
+          input[j] = inputs[(i * input.size() + j) & 0xffff];
+        }
+        heap.clear();
+        model.predict(input, 1, 0.0, heap, state);
+      }
+    });
+  }
+}
+
+// Trains a supervised model on a corpus of -size bytes, then benchmarks
+// its inference and loading.
+void benchFastText(Runner& runner, const Options& options) {
+  std::string trainPath = options.dir + "/fasttext-bench-train.txt";
+  std::string testPath = options.dir + "/fasttext-bench-test.txt";
+  std::string modelPath = options.dir + "/fasttext-bench-model";
+  std::vector<std::string> files = {trainPath,
+                                    testPath,
+                                    modelPath + ".bin",
+                                    modelPath + ".compressed.bin"};
+  CorpusOptions corpus = getCorpusOptions(options);
+  writeCorpus(trainPath, corpus, 0, options.size);
+  corpus.seed++;
+  writeCorpus(testPath, corpus, 10000, 0);
+
+  Args args;
+  args.input = trainPath;
+  args.output = modelPath;
+  args.model = model_name::sup;
+  args.loss = loss_name::softmax;
+  args.minCount = 1;
+  args.minn = 3;
+  args.maxn = 6;
+  args.wordNgrams = 2;
+  args.bucket = 200000;
+  args.epoch = 5;
+  args.lr = 0.5;
+  args.thread = options.thread;
+  args.verbose = 0;
+  FastText fasttext;
+  auto start = std::chrono::steady_clock::now();
+  fasttext.train(args);
+  double seconds = utils::getDuration(start, std::chrono::steady_clock::now());
+  int64_t tokens = fasttext.getDictionary()->ntokens();
+  runner.record(
+      "train/supervised/threads=" + std::to_string(args.thread),
+      seconds,
+      tokens * args.epoch);
+
+  std::ifstream in(testPath);
+  std::vector<std::pair<real, std::string>> predictions;
+  FastText::Context context;
+  int64_t lines = 0;
+  start = std::chrono::steady_clock::now();
+  while (fasttext.predictLine(in, predictions, 1, 0.0, context)) {
+    lines++;
+  }
+  seconds = utils::getDuration(start, std::chrono::steady_clock::now());
+  runner.record("predict/supervised", seconds, lines);
+
+  std::string word = fasttext.getDictionary()->getWord(0);
+  fasttext.getNN(word, 10); // computes the word vectors
+  runner.run("fasttext/getNN", [&](int64_t n) {
+    for (int64_t i = 0; i < n; i++) {
+      fasttext.getNN(word, 10);
+    }
+  });
+
+  fasttext.saveModel(files[2]);
+  SaveOptions compressed;
+  compressed.compress = true;
+  compressed.thread = options.thread;
+  fasttext.saveModel(files[3], compressed);
+  LoadOptions load;
+  load.thread = options.thread;
+  runner.run("fasttext/loadModel/uncompressed", [&](int64_t n) {
+    for (int64_t i = 0; i < n; i++) {
+      FastText().loadModel(files[2], load);
+    }
+  });
+  runner.run("fasttext/loadModel/compressed", [&](int64_t n) {
+    for (int64_t i = 0; i < n; i++) {
+      FastText().loadModel(files[3], load);
+    }
+  });
+  for (const auto& file : files) {
+    std::remove(file.c_str());
+  }
+}
+
+void printUsage() {
+  std::cerr
+      << "usage: fasttext-bench <args>\n\n"
+      << "  -filter     run the benchmarks whose name contains it []\n"
+      << "  -output     file receiving the results as JSON lines [stdout]\n"
+      << "  -dir        directory of the temporary files [$TMPDIR or /tmp]\n"
+      << "  -minTime    minimum seconds of a measured run [0.2]\n"
+      << "  -repeats    measured runs of each benchmark [5]\n"
+      << "  -size       bytes of the training corpus [4M]\n"
+      << "  -words      vocabulary size of the corpus [100000]\n"
+      << "  -labels     labels of the corpus [200]\n"
+      << "  -thread     threads of training, saving and loading [cores]\n"
+      << std::endl;
+}
+
+Options parseOptions(const std::vector<std::string>& args) {
+  Options options;
+  for (size_t i = 1; i < args.size(); i += 2) {
+    if (args[i] == "-h" || args[i] == "-help" || i + 1 >= args.size()) {
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+    const std::string& value = args[i + 1];
+    if (args[i] == "-filter") {
+      options.filter = value;
+    } else if (args[i] == "-output") {
+      options.output = value;
+    } else if (args[i] == "-dir") {
+      options.dir = value;
+    } else if (args[i] == "-minTime") {
+      options.minTime = std::stod(value);
+    } else if (args[i] == "-repeats") {
+      options.repeats = std::max(1, std::stoi(value));
+    } else if (args[i] == "-size") {
+      options.size = CorpusGenerator::parseSize(value);
+    } else if (args[i] == "-words") {
+      options.words = std::stoi(value);
+    } else if (args[i] == "-labels") {
+      options.labels = std::stoi(value);
+    } else if (args[i] == "-thread") {
+      options.thread = std::max(1, std::stoi(value));
+    } else {
+      std::cerr << "Unknown argument: " << args[i] << std::endl;
+      printUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> args(argv, argv + argc);
+  Options options = parseOptions(args);
+  EventLog log(options.output.empty() ? "fd:1" : options.output);
+  log.write(Event("context")
+                .add("cores", int32_t(std::thread::hardware_concurrency()))
+                .add("realBytes", int32_t(sizeof(real)))
+                .add("size", options.size)
+                .add("words", options.words)
+                .add("labels", options.labels)
+                .add("thread", options.thread)
+                .add("minTime", options.minTime)
+                .add("repeats", options.repeats));
+  Runner runner(options, log);
+
+  benchMatrix(runner);
+  benchProductQuantizer(runner);
+  benchCorpus(runner, options);
+  benchDictionary(runner, options);
+  benchLosses(runner);
+  if (runner.enabled("train/") || runner.enabled("predict/") ||
+      runner.enabled("fasttext/")) {
+    benchFastText(runner, options);
+  }
+  return 0;
+}
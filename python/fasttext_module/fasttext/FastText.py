@@ -17,6 +17,7 @@ from itertools import chain
 
 loss_name = fasttext.loss_name
 model_name = fasttext.model_name
+quant_name = fasttext.quant_name
 EOS = "</s>"
 BOW = "<"
 EOW = ">"
@@ -160,7 +161,9 @@ class _FastText(object):
 
     def get_subword_id(self, subword):
         """
-        Given a subword, return the index (within input matrix) it hashes to.
+        Given a subword, return the index (within input matrix) it hashes to,
+        or -1 if the model was trained with compactBuckets and no training
+        word had a subword in that bucket.
         """
         return self.f.getSubwordId(subword)
 
@@ -297,9 +300,12 @@ class _FastText(object):
             text = check(text)
             return self.f.getLine(text, on_unicode_error)
 
-    def save_model(self, path):
-        """Save the model to the given path"""
-        self.f.saveModel(path)
+    def save_model(self, path, compress=False):
+        """
+        Save the model to the given path. compress stores the sections of
+        the model compressed, which are decompressed when loading it.
+        """
+        self.f.saveModel(path, compress)
 
     def test(self, path, k=1, threshold=0.0):
         """Evaluate supervised model using file given by path"""
@@ -332,11 +338,13 @@ class _FastText(object):
         thread=None,
         verbose=None,
         dsub=2,
-        qnorm=False
+        qnorm=False,
+        qtype="pq"
     ):
         """
         Quantize the model reducing the size of the model and
-        it's memory footprint.
+        it's memory footprint. qtype is one of "pq" (product quantization),
+        "int8" or "fp16".
         """
         a = self.f.getArgs()
         if not epoch:
@@ -353,7 +361,7 @@ class _FastText(object):
             input = ""
         self.f.quantize(
             input, qout, cutoff, retrain, epoch, lr, thread, verbose, dsub,
-            qnorm
+            qnorm, _parse_quant_string(qtype)
         )
 
     def set_matrices(self, input_matrix, output_matrix):
@@ -407,6 +415,17 @@ def _parse_loss_string(string):
         raise ValueError("Unrecognized loss name")
 
 
+def _parse_quant_string(string):
+    if string == "pq":
+        return quant_name.pq
+    if string == "int8":
+        return quant_name.int8
+    if string == "fp16":
+        return quant_name.fp16
+    else:
+        raise ValueError("Unrecognized quantization type")
+
+
 def _build_args(args, manually_set_args):
     args["model"] = _parse_model_string(args["model"])
     args["loss"] = _parse_loss_string(args["loss"])
@@ -436,6 +455,50 @@ def load_model(path):
     return _FastText(model_path=path)
 
 
+class ModelGroup(object):
+    """
+    Supervised models with the same words and input matrix, each with its
+    own labels, for instance trained from the same pretrained vectors. The
+    dictionary and input matrix of the first model are shared by the
+    others, and adding a model with other words or another input matrix
+    raises a ValueError.
+    """
+
+    def __init__(self, paths=None):
+        self.g = fasttext.modelGroup()
+        if paths is not None:
+            for path in paths:
+                self.add(path)
+
+    def add(self, path):
+        """Load the model at the given path and add it to the group"""
+        self.g.add(path)
+
+    def __len__(self):
+        return self.g.size()
+
+    def predict(self, text, k=1, threshold=0.0, on_unicode_error='strict'):
+        """
+        Given a single line of text, return the labels and probabilities
+        predicted by each model, in the order they were added, as the
+        predict function of a model would.
+        """
+        if text.find('\n') != -1:
+            raise ValueError(
+                "predict processes one line at a time (remove \'\\n\')"
+            )
+        results = []
+        for predictions in self.g.predict(
+            text + "\n", k, threshold, on_unicode_error
+        ):
+            if predictions:
+                probs, labels = zip(*predictions)
+            else:
+                probs, labels = ([], ())
+            results.append((labels, np.array(probs, copy=False)))
+        return results
+
+
 unsupervised_default = {
     'model': "skipgram",
     'lr': 0.05,
@@ -461,7 +524,8 @@ unsupervised_default = {
     'autotuneMetric': "f1",
     'autotunePredictions': 1,
     'autotuneDuration': 60 * 5,  # 5 minutes
-    'autotuneModelSize': ""
+    'autotuneModelSize': "",
+    'compactBuckets': False
 }
 
 
@@ -520,7 +584,8 @@ def train_supervised(*kargs, **kwargs):
                  'minCountLabel', 'minn', 'maxn', 'neg', 'wordNgrams', 'loss', 'bucket',
                  'thread', 'lrUpdateRate', 't', 'label', 'verbose', 'pretrainedVectors',
                  'seed', 'autotuneValidationFile', 'autotuneMetric',
-                 'autotunePredictions', 'autotuneDuration', 'autotuneModelSize']
+                 'autotunePredictions', 'autotuneDuration', 'autotuneModelSize',
+                 'compactBuckets']
     args, manually_set_args = read_args(kargs, kwargs, arg_names,
                                         supervised_default)
     a = _build_args(args, manually_set_args)
@@ -546,7 +611,8 @@ def train_unsupervised(*kargs, **kwargs):
     """
     arg_names = ['input', 'model', 'lr', 'dim', 'ws', 'epoch', 'minCount',
                  'minCountLabel', 'minn', 'maxn', 'neg', 'wordNgrams', 'loss', 'bucket',
-                 'thread', 'lrUpdateRate', 't', 'label', 'verbose', 'pretrainedVectors']
+                 'thread', 'lrUpdateRate', 't', 'label', 'verbose', 'pretrainedVectors',
+                 'compactBuckets']
     args, manually_set_args = read_args(kargs, kwargs, arg_names,
                                         unsupervised_default)
     a = _build_args(args, manually_set_args)
@@ -12,6 +12,7 @@ from __future__ import unicode_literals
 from .FastText import train_supervised
 from .FastText import train_unsupervised
 from .FastText import load_model
+from .FastText import ModelGroup
 from .FastText import tokenize
 from .FastText import EOS
 from .FastText import BOW
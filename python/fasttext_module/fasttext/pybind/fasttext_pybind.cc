@@ -10,6 +10,7 @@
 #include <autotune.h>
 #include <densematrix.h>
 #include <fasttext.h>
+#include <modelgroup.h>
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
@@ -110,12 +111,14 @@ PYBIND11_MODULE(fasttext_pybind, m) {
       .def_readwrite("pretrainedVectors", &fasttext::Args::pretrainedVectors)
       .def_readwrite("saveOutput", &fasttext::Args::saveOutput)
       .def_readwrite("seed", &fasttext::Args::seed)
+      .def_readwrite("compactBuckets", &fasttext::Args::compactBuckets)
 
       .def_readwrite("qout", &fasttext::Args::qout)
       .def_readwrite("retrain", &fasttext::Args::retrain)
       .def_readwrite("qnorm", &fasttext::Args::qnorm)
       .def_readwrite("cutoff", &fasttext::Args::cutoff)
       .def_readwrite("dsub", &fasttext::Args::dsub)
+      .def_readwrite("qtype", &fasttext::Args::qtype)
 
       .def_readwrite(
           "autotuneValidationFile", &fasttext::Args::autotuneValidationFile)
@@ -141,6 +144,12 @@ PYBIND11_MODULE(fasttext_pybind, m) {
       .value("ova", fasttext::loss_name::ova)
       .export_values();
 
+  py::enum_<fasttext::quant_name>(m, "quant_name")
+      .value("pq", fasttext::quant_name::pq)
+      .value("int8", fasttext::quant_name::int8)
+      .value("fp16", fasttext::quant_name::fp16)
+      .export_values();
+
   py::enum_<fasttext::metric_name>(m, "metric_name")
       .value("f1score", fasttext::metric_name::f1score)
       .value("f1scoreLabel", fasttext::metric_name::f1scoreLabel)
@@ -265,7 +274,11 @@ PYBIND11_MODULE(fasttext_pybind, m) {
           [](fasttext::FastText& m, std::string s) { m.loadModel(s); })
       .def(
           "saveModel",
-          [](fasttext::FastText& m, std::string s) { m.saveModel(s); })
+          [](fasttext::FastText& m, std::string s, bool compress) {
+            fasttext::SaveOptions options;
+            options.compress = compress;
+            m.saveModel(s, options);
+          })
       .def(
           "test",
           [](fasttext::FastText& m,
@@ -376,7 +389,8 @@ PYBIND11_MODULE(fasttext_pybind, m) {
              int thread,
              int verbose,
              int32_t dsub,
-             bool qnorm) {
+             bool qnorm,
+             fasttext::quant_name qtype) {
             fasttext::Args qa = fasttext::Args();
             qa.input = input;
             qa.qout = qout;
@@ -388,6 +402,7 @@ PYBIND11_MODULE(fasttext_pybind, m) {
             qa.verbose = verbose;
             qa.dsub = dsub;
             qa.qnorm = qnorm;
+            qa.qtype = qtype;
             m.quantize(qa);
           })
       .def(
@@ -417,10 +432,11 @@ PYBIND11_MODULE(fasttext_pybind, m) {
             std::vector<py::array_t<fasttext::real>> allProbabilities;
             std::vector<std::vector<py::str>> allLabels;
             std::vector<std::pair<fasttext::real, std::string>> predictions;
+            fasttext::FastText::Context context;
 
             for (const std::string& text : lines) {
               std::stringstream ioss(text);
-              m.predictLine(ioss, predictions, k, threshold);
+              m.predictLine(ioss, predictions, k, threshold, context);
               std::vector<fasttext::real> probabilities;
               std::vector<py::str> labels;
 
@@ -524,4 +540,33 @@ PYBIND11_MODULE(fasttext_pybind, m) {
                 transformedSubwords, ngrams);
           })
       .def("isQuant", [](fasttext::FastText& m) { return m.isQuant(); });
+
+  py::class_<fasttext::ModelGroup>(m, "modelGroup")
+      .def(py::init<>())
+      .def(
+          "add",
+          [](fasttext::ModelGroup& m, const std::string& s) { m.add(s); })
+      .def("size", &fasttext::ModelGroup::size)
+      .def(
+          "predict",
+          // NOTE: text needs to end in a newline
+          [](const fasttext::ModelGroup& m,
+             const std::string text,
+             int32_t k,
+             fasttext::real threshold,
+             const char* onUnicodeError) {
+            std::stringstream ioss(text);
+            fasttext::ModelGroup::Context context;
+            std::vector<std::vector<std::pair<fasttext::real, std::string>>>
+                predictions;
+            m.predictLine(ioss, predictions, k, threshold, context);
+
+            std::vector<std::vector<std::pair<fasttext::real, py::str>>>
+                transformedPredictions;
+            for (const auto& p : predictions) {
+              transformedPredictions.push_back(
+                  castToPythonString(p, onUnicodeError));
+            }
+            return transformedPredictions;
+          });
 }
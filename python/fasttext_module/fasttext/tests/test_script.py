@@ -18,6 +18,7 @@ import subprocess
 import unittest
 import tempfile
 import random
+import struct
 import sys
 import copy
 import numpy as np
@@ -151,6 +152,26 @@ def read_labels(data_file):
     return lines, labels
 
 
+def save_model_v13(model, path):
+    # Version 13 models are the args, dictionary, input and output matrices
+    # that version 14 stores in sections, saved uncompressed here.
+    with tempfile.NamedTemporaryFile(delete=False) as tmpf:
+        model.save_model(tmpf.name)
+        with open(tmpf.name, "rb") as f:
+            data = f.read()
+    magic, version, nsections = struct.unpack_from("<iii", data, 0)
+    sections = {}
+    for i in range(nsections):
+        section_id, flags, offset, size, checksum = struct.unpack_from(
+            "<iiqqI", data, 12 + 28 * i
+        )
+        sections[section_id] = data[offset:offset + size]
+    with open(path, "wb") as f:
+        f.write(struct.pack("<ii", magic, 13))
+        for section_id in [1, 2, 3, 4]:
+            f.write(sections[section_id])
+
+
 class TestFastTextUnitPy(unittest.TestCase):
     # TODO: Unit test copy behavior of fasttext
 
@@ -429,6 +450,119 @@ class TestFastTextUnitPy(unittest.TestCase):
         f.quantize()
         self.assertTrue(f.is_quantized())
 
+    def gen_test_supervised_save_load(self, kwargs):
+        def check(model, lines):
+            for compress in [False, True]:
+                with tempfile.NamedTemporaryFile(delete=False) as tmpf:
+                    model.save_model(tmpf.name, compress=compress)
+                    loaded = fasttext.load_model(tmpf.name)
+                self.assertEqual(model.is_quantized(), loaded.is_quantized())
+                self.assertEqual(model.get_words(), loaded.get_words())
+                self.assertEqual(model.get_labels(), loaded.get_labels())
+                for line in lines:
+                    labels1, probs1 = model.predict(line, k=5)
+                    labels2, probs2 = loaded.predict(line, k=5)
+                    self.assertEqual(list(labels1), list(labels2))
+                    self.assertTrue(
+                        np.isclose(probs1, probs2, atol=1e-5, rtol=0).all()
+                    )
+
+        data = get_random_data(1000, max_vocab_size=1000)
+        lines = get_random_data(10)
+        check(build_supervised_model(data, kwargs), lines)
+        for qtype in ["pq", "int8", "fp16"]:
+            f = build_supervised_model(data, kwargs)
+            # product quantization of the output needs 256 labels
+            f.quantize(qtype=qtype, qout=(qtype != "pq"))
+            check(f, lines)
+
+    def gen_test_supervised_load_version_13(self, kwargs):
+        data = get_random_data(1000, max_vocab_size=1000)
+        lines = get_random_data(10)
+        for qtype in [None, "pq", "int8", "fp16"]:
+            f = build_supervised_model(data, kwargs)
+            if qtype is not None:
+                f.quantize(qtype=qtype)
+            with tempfile.NamedTemporaryFile(delete=False) as tmpf:
+                save_model_v13(f, tmpf.name)
+                loaded = fasttext.load_model(tmpf.name)
+            self.assertEqual(f.is_quantized(), loaded.is_quantized())
+            self.assertEqual(f.get_words(), loaded.get_words())
+            for line in lines:
+                labels1, probs1 = f.predict(line, k=5)
+                labels2, probs2 = loaded.predict(line, k=5)
+                self.assertEqual(list(labels1), list(labels2))
+                self.assertTrue(
+                    np.isclose(probs1, probs2, atol=1e-5, rtol=0).all()
+                )
+
+    def gen_test_compact_buckets(self, kwargs):
+        kwargs["compactBuckets"] = True
+        f = build_unsupervised_model(get_random_data(100), kwargs)
+        with tempfile.NamedTemporaryFile(delete=False) as tmpf:
+            f.save_model(tmpf.name)
+            loaded = fasttext.load_model(tmpf.name)
+        nrows = f.get_input_matrix().shape[0]
+        words = f.get_words()
+        for word in words + get_random_words(100, 1, 20):
+            subwords, subinds = f.get_subwords(word)
+            for subind in subinds:
+                self.assertTrue(0 <= subind < nrows)
+            if f.bucket > 0:
+                for subword in subwords:
+                    subid = f.get_subword_id(subword)
+                    # the bucket of an unseen subword may have been dropped
+                    self.assertTrue(-1 <= subid < nrows)
+                    if word in words and subword != word:
+                        self.assertTrue(subid >= 0)
+            vec1 = f.get_word_vector(word)
+            vec2 = loaded.get_word_vector(word)
+            self.assertTrue(np.isclose(vec1, vec2, atol=1e-5, rtol=0).all())
+
+    def gen_test_supervised_model_group(self, kwargs):
+        f = build_supervised_model(
+            get_random_data(100, min_words_line=1), kwargs
+        )
+        with tempfile.NamedTemporaryFile(
+            delete=False
+        ) as tmpf, tempfile.NamedTemporaryFile(delete=False) as tmpf2:
+            f.save_model(tmpf.name)
+            # same words and input matrix, other output matrix
+            f.set_matrices(
+                f.get_input_matrix(),
+                np.ascontiguousarray(f.get_output_matrix()[::-1])
+            )
+            f.save_model(tmpf2.name)
+            group = fasttext.ModelGroup([tmpf.name, tmpf2.name])
+            models = [
+                fasttext.load_model(tmpf.name),
+                fasttext.load_model(tmpf2.name)
+            ]
+        self.assertEqual(len(group), 2)
+        for line in get_random_data(10):
+            for k in [1, 2, 5]:
+                predictions = group.predict(line, k)
+                self.assertEqual(len(predictions), 2)
+                for model, (labels1, probs1) in zip(models, predictions):
+                    labels2, probs2 = model.predict(line, k)
+                    self.assertEqual(list(labels1), list(labels2))
+                    self.assertTrue(
+                        np.isclose(probs1, probs2, atol=1e-5, rtol=0).all()
+                    )
+
+        other = build_supervised_model(
+            get_random_data(100, min_words_line=1), kwargs
+        )
+        gotError = False
+        with tempfile.NamedTemporaryFile(delete=False) as tmpf:
+            other.save_model(tmpf.name)
+            try:
+                group.add(tmpf.name)
+            except ValueError:
+                gotError = True
+        self.assertTrue(gotError)
+        self.assertEqual(len(group), 2)
+
     def gen_test_newline_predict_sentence(self, kwargs):
         f = build_supervised_model(get_random_data(100), kwargs)
         sentence = " ".join(get_random_words(20))
@@ -0,0 +1,76 @@
+#!/usr/bin/env bash
+#
+# Copyright (c) 2016-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+# This script trains a supervised model with NODES processes of THREADS
+# threads on this machine, once averaging the full matrices and once
+# exchanging only the updated rows, and checks that both models reach the
+# precision of a single process with NODES * THREADS threads.
+#
+# usage: local-test.sh <train file> <test file> [fasttext arguments]
+
+set -e
+
+FASTTEXT=${FASTTEXT:-./fasttext}
+NODES=${NODES:-4}
+THREADS=${THREADS:-2}
+PORT=${PORT:-7070}
+RESULTDIR=${RESULTDIR:-result/distributed}
+
+TRAIN=$1
+TEST=$2
+shift 2
+
+mkdir -p "${RESULTDIR}"
+
+# Starts the processes and waits for all of them. Only process 0 saves
+# the model and logs its progress.
+train() {
+  local output=$1
+  shift
+  local pids=()
+  for (( rank = NODES - 1; rank >= 0; rank-- )); do
+    local verbose=0
+    if [ ${rank} -eq 0 ]; then
+      verbose=2
+    fi
+    "${FASTTEXT}" supervised -input "${TRAIN}" -output "${output}" \
+      -nodes ${NODES} -rank ${rank} -coordinator 127.0.0.1:${PORT} \
+      -thread ${THREADS} -verbose ${verbose} "$@" &
+    pids+=($!)
+  done
+  local status=0
+  for pid in "${pids[@]}"; do
+    wait "${pid}" || status=1
+  done
+  return ${status}
+}
+
+precision() {
+  "${FASTTEXT}" test "$1" "${TEST}" | awk '$1 == "P@1" { print $2 }'
+}
+
+close() {
+  awk -v a="$1" -v b="$2" \
+    'BEGIN { d = a - b; if (d < 0) d = -d; exit !(d <= 0.01) }'
+}
+
+echo "Training a single process"
+"${FASTTEXT}" supervised -input "${TRAIN}" -output "${RESULTDIR}/single" \
+  -thread $(( NODES * THREADS )) "$@"
+echo "Averaging the full matrices"
+train "${RESULTDIR}/full" "$@"
+echo "Exchanging the updated rows"
+train "${RESULTDIR}/sparse" -sparseSync "$@"
+
+SINGLE=$(precision "${RESULTDIR}/single.bin")
+FULL=$(precision "${RESULTDIR}/full.bin")
+SPARSE=$(precision "${RESULTDIR}/sparse.bin")
+echo "P@1 single: ${SINGLE} full: ${FULL} sparse: ${SPARSE}"
+close "${SINGLE}" "${FULL}"
+close "${SINGLE}" "${SPARSE}"
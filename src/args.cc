@@ -29,6 +29,7 @@ Args::Args() {
   loss = loss_name::ns;
   model = model_name::sg;
   bucket = 2000000;
+  compactBuckets = false;
   minn = 3;
   maxn = 6;
   thread = 12;
@@ -38,11 +39,30 @@ Args::Args() {
   verbose = 2;
   pretrainedVectors = "";
   saveOutput = false;
+  saveBinaryVectors = false;
+  compress = false;
+  checkpoint = 0;
+  resume = false;
+  inputModel = "";
+  streamTokens = 0;
+  streamDuration = 0;
+  nodes = 1;
+  rank = 0;
+  coordinator = "127.0.0.1:7070";
+  syncTokens = 1000000;
+  sparseSync = false;
+  trainStats = "";
+  events = "";
+  statsInterval = 10;
   seed = 0;
+  precision = precision_name::fp32;
 
   qout = false;
   retrain = false;
   qnorm = false;
+  qrotate = false;
+  qretrain = false;
+  qtype = quant_name::pq;
   cutoff = 0;
   dsub = 2;
 
@@ -87,6 +107,30 @@ std::string Args::modelToString(model_name mn) const {
   return "Unknown model name!"; // should never happen
 }
 
+std::string Args::quantToString(quant_name qn) const {
+  switch (qn) {
+    case quant_name::pq:
+      return "pq";
+    case quant_name::int8:
+      return "int8";
+    case quant_name::fp16:
+      return "fp16";
+  }
+  return "Unknown quantization type!"; // should never happen
+}
+
+std::string Args::precisionToString(precision_name pn) const {
+  switch (pn) {
+    case precision_name::fp32:
+      return "fp32";
+    case precision_name::fp16:
+      return "fp16";
+    case precision_name::bf16:
+      return "bf16";
+  }
+  return "Unknown precision!"; // should never happen
+}
+
 std::string Args::metricToString(metric_name mn) const {
   switch (mn) {
     case metric_name::f1score:
@@ -169,6 +213,9 @@ void Args::parseArgs(const std::vector<std::string>& args) {
         }
       } else if (args[ai] == "-bucket") {
         bucket = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-compactBuckets") {
+        compactBuckets = true;
+        ai--;
       } else if (args[ai] == "-minn") {
         minn = std::stoi(args.at(ai + 1));
       } else if (args[ai] == "-maxn") {
@@ -186,17 +233,82 @@ void Args::parseArgs(const std::vector<std::string>& args) {
       } else if (args[ai] == "-saveOutput") {
         saveOutput = true;
         ai--;
+      } else if (args[ai] == "-saveBinaryVectors") {
+        saveBinaryVectors = true;
+        ai--;
+      } else if (args[ai] == "-compress") {
+        compress = true;
+        ai--;
+      } else if (args[ai] == "-checkpoint") {
+        checkpoint = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-resume") {
+        resume = true;
+        ai--;
+      } else if (args[ai] == "-inputModel") {
+        inputModel = std::string(args.at(ai + 1));
+      } else if (args[ai] == "-streamTokens") {
+        streamTokens = std::stoll(args.at(ai + 1));
+      } else if (args[ai] == "-streamDuration") {
+        streamDuration = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-nodes") {
+        nodes = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-rank") {
+        rank = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-coordinator") {
+        coordinator = std::string(args.at(ai + 1));
+      } else if (args[ai] == "-syncTokens") {
+        syncTokens = std::stoll(args.at(ai + 1));
+      } else if (args[ai] == "-sparseSync") {
+        sparseSync = true;
+        ai--;
+      } else if (args[ai] == "-trainStats") {
+        trainStats = std::string(args.at(ai + 1));
+      } else if (args[ai] == "-events") {
+        events = std::string(args.at(ai + 1));
+      } else if (args[ai] == "-statsInterval") {
+        statsInterval = std::stoi(args.at(ai + 1));
       } else if (args[ai] == "-seed") {
         seed = std::stoi(args.at(ai + 1));
+      } else if (args[ai] == "-precision") {
+        if (args.at(ai + 1) == "fp32") {
+          precision = precision_name::fp32;
+        } else if (args.at(ai + 1) == "fp16") {
+          precision = precision_name::fp16;
+        } else if (args.at(ai + 1) == "bf16") {
+          precision = precision_name::bf16;
+        } else {
+          std::cerr << "Unknown precision: " << args.at(ai + 1) << std::endl;
+          printHelp();
+          exit(EXIT_FAILURE);
+        }
       } else if (args[ai] == "-qnorm") {
         qnorm = true;
         ai--;
+      } else if (args[ai] == "-qrotate") {
+        qrotate = true;
+        ai--;
+      } else if (args[ai] == "-qretrain") {
+        qretrain = true;
+        ai--;
       } else if (args[ai] == "-retrain") {
         retrain = true;
         ai--;
       } else if (args[ai] == "-qout") {
         qout = true;
         ai--;
+      } else if (args[ai] == "-qtype") {
+        if (args.at(ai + 1) == "pq") {
+          qtype = quant_name::pq;
+        } else if (args.at(ai + 1) == "int8") {
+          qtype = quant_name::int8;
+        } else if (args.at(ai + 1) == "fp16") {
+          qtype = quant_name::fp16;
+        } else {
+          std::cerr << "Unknown quantization type: " << args.at(ai + 1)
+                    << std::endl;
+          printHelp();
+          exit(EXIT_FAILURE);
+        }
       } else if (args[ai] == "-cutoff") {
         cutoff = std::stoi(args.at(ai + 1));
       } else if (args[ai] == "-dsub") {
@@ -259,6 +371,9 @@ void Args::printDictionaryHelp() {
             << "  -wordNgrams         max length of word ngram [" << wordNgrams
             << "]\n"
             << "  -bucket             number of buckets [" << bucket << "]\n"
+            << "  -compactBuckets     only allocate buckets used by the "
+               "training data ["
+            << boolToString(compactBuckets) << "]\n"
             << "  -minn               min length of char ngram [" << minn
             << "]\n"
             << "  -maxn               max length of char ngram [" << maxn
@@ -288,7 +403,49 @@ void Args::printTrainingHelp() {
       << pretrainedVectors << "]\n"
       << "  -saveOutput         whether output params should be saved ["
       << boolToString(saveOutput) << "]\n"
-      << "  -seed               random generator seed  [" << seed << "]\n";
+      << "  -saveBinaryVectors  whether word vectors are also saved in binary "
+         "format ["
+      << boolToString(saveBinaryVectors) << "]\n"
+      << "  -compress           whether model sections are compressed ["
+      << boolToString(compress) << "]\n"
+      << "  -checkpoint         seconds between checkpoints to <output>.ckpt, "
+         "0 to disable ["
+      << checkpoint << "]\n"
+      << "  -resume             whether training resumes from <output>.ckpt ["
+      << boolToString(resume) << "]\n"
+      << "  -inputModel         model to continue training from with update ["
+      << inputModel << "]\n"
+      << "  -streamTokens       tokens over which lr decays when training "
+         "from stdin, 0 for epoch times the tokens of the dictionary ["
+      << streamTokens << "]\n"
+      << "  -streamDuration     seconds over which lr decays when training "
+         "from stdin, 0 to decay by tokens ["
+      << streamDuration << "]\n"
+      << "  -nodes              number of processes training together ["
+      << nodes << "]\n"
+      << "  -rank               rank of this process, from 0 to nodes - 1 ["
+      << rank << "]\n"
+      << "  -coordinator        host:port on which process 0 listens ["
+      << coordinator << "]\n"
+      << "  -syncTokens         tokens of each process between parameter "
+         "averagings ["
+      << syncTokens << "]\n"
+      << "  -sparseSync         whether only the rows updated since the last "
+         "averaging are exchanged ["
+      << boolToString(sparseSync) << "]\n"
+      << "  -trainStats         file receiving training time by step as JSON "
+         "lines ["
+      << trainStats << "]\n"
+      << "  -events             file, or fd:<n>, receiving progress and "
+         "autotune events as JSON lines ["
+      << events << "]\n"
+      << "  -statsInterval      seconds between lines of -trainStats and "
+         "progress events ["
+      << statsInterval << "]\n"
+      << "  -seed               random generator seed  [" << seed << "]\n"
+      << "  -precision          storage of parameters during training "
+         "{fp32, fp16, bf16} ["
+      << precisionToString(precision) << "]\n";
 }
 
 void Args::printAutotuneHelp() {
@@ -310,6 +467,8 @@ void Args::printAutotuneHelp() {
 void Args::printQuantizationHelp() {
   std::cerr
       << "\nThe following arguments for quantization are optional:\n"
+      << "  -qtype              quantization type {pq, int8, fp16} ["
+      << quantToString(qtype) << "]\n"
       << "  -cutoff             number of words and ngrams to retain ["
       << cutoff << "]\n"
       << "  -retrain            whether embeddings are finetuned if a cutoff "
@@ -319,6 +478,12 @@ void Args::printQuantizationHelp() {
       << boolToString(qnorm) << "]\n"
       << "  -qout               whether the classifier is quantized ["
       << boolToString(qout) << "]\n"
+      << "  -qrotate            whether vectors are randomly rotated before "
+         "quantization ["
+      << boolToString(qrotate) << "]\n"
+      << "  -qretrain           whether codebooks are finetuned after "
+         "quantization ["
+      << boolToString(qretrain) << "]\n"
       << "  -dsub               size of each sub-vector [" << dsub << "]\n";
 }
 
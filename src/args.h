@@ -18,6 +18,8 @@ namespace fasttext {
 
 enum class model_name : int { cbow = 1, sg, sup };
 enum class loss_name : int { hs = 1, ns, softmax, ova };
+enum class quant_name : int { pq = 1, int8, fp16 };
+enum class precision_name : int { fp32 = 1, fp16, bf16 };
 enum class metric_name : int {
   f1score = 1,
   f1scoreLabel,
@@ -32,6 +34,8 @@ class Args {
   std::string boolToString(bool) const;
   std::string modelToString(model_name) const;
   std::string metricToString(metric_name) const;
+  std::string quantToString(quant_name) const;
+  std::string precisionToString(precision_name) const;
   std::unordered_set<std::string> manualArgs_;
 
  public:
@@ -50,6 +54,7 @@ class Args {
   loss_name loss;
   model_name model;
   int bucket;
+  bool compactBuckets;
   int minn;
   int maxn;
   int thread;
@@ -58,11 +63,30 @@ class Args {
   int verbose;
   std::string pretrainedVectors;
   bool saveOutput;
+  bool saveBinaryVectors;
+  bool compress;
+  int checkpoint;
+  bool resume;
+  std::string inputModel;
+  int64_t streamTokens;
+  int streamDuration;
+  int nodes;
+  int rank;
+  std::string coordinator;
+  int64_t syncTokens;
+  bool sparseSync;
+  std::string trainStats;
+  std::string events;
+  int statsInterval;
   int seed;
+  precision_name precision;
 
   bool qout;
   bool retrain;
   bool qnorm;
+  bool qrotate;
+  bool qretrain;
+  quant_name qtype;
   size_t cutoff;
   size_t dsub;
 
@@ -237,12 +237,28 @@ void Autotune::printInfo(double maxDuration) {
 
 void Autotune::timer(
     const std::chrono::steady_clock::time_point& start,
-    double maxDuration) {
+    double maxDuration,
+    int32_t eventInterval) {
   elapsed_ = 0.0;
+  double lastEvent = 0.0;
   while (keepTraining(maxDuration)) {
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
     elapsed_ = utils::getDuration(start, std::chrono::steady_clock::now());
     printInfo(maxDuration);
+    if (events_ && elapsed_ - lastEvent >= eventInterval) {
+      events_->write(
+          Event("autotuneProgress")
+              .add("seconds", double(elapsed_))
+              .add("progress", std::min(elapsed_ / maxDuration, 1.0))
+              .add("trials", trials_)
+              .add(
+                  "bestScore",
+                  bestScore_ == kUnknownBestScore
+                      ? std::numeric_limits<double>::quiet_NaN()
+                      : bestScore_)
+              .add("residentBytes", utils::getResidentMemory()));
+      lastEvent = elapsed_;
+    }
   }
   abort();
 }
@@ -261,10 +277,12 @@ void Autotune::abort() {
 void Autotune::startTimer(const Args& args) {
   std::chrono::steady_clock::time_point start =
       std::chrono::steady_clock::now();
-  timer_ = std::thread([=]() { timer(start, args.autotuneDuration); });
   bestScore_ = kUnknownBestScore;
   trials_ = 0;
+  // set before the timer checks it
   continueTraining_ = true;
+  timer_ = std::thread(
+      [=]() { timer(start, args.autotuneDuration, args.statsInterval); });
 
   auto previousSignalHandler = std::signal(SIGINT, signalHandler);
   interruptSignalHandler = [&]() {
@@ -318,6 +336,28 @@ void Autotune::printArgs(const Args& args, const Args& autotuneArgs) {
   LOG_VAL(loss, args.lossToString(args.loss))
 }
 
+void Autotune::writeTrialEvent(
+    const std::string& type,
+    const Args& args,
+    double score,
+    double seconds) {
+  events_->write(Event(type)
+                     .add("trial", trials_)
+                     .add("score", score)
+                     .add("seconds", seconds)
+                     .add("epoch", args.epoch)
+                     .add("lr", args.lr)
+                     .add("dim", args.dim)
+                     .add("minCount", args.minCount)
+                     .add("wordNgrams", args.wordNgrams)
+                     .add("minn", args.minn)
+                     .add("maxn", args.maxn)
+                     .add("bucket", args.bucket)
+                     .add("dsub", int64_t(args.dsub))
+                     .add("loss", args.lossToString(args.loss))
+                     .add("cutoff", int64_t(args.cutoff)));
+}
+
 int Autotune::getCutoffForFileSize(
     bool qout,
     bool qnorm,
@@ -386,6 +426,10 @@ void Autotune::train(const Args& autotuneArgs) {
     throw std::invalid_argument("Validation file cannot be opened!");
   }
   printSkippedArgs(autotuneArgs);
+  if (!autotuneArgs.events.empty() && !fastText_->getEventLog()) {
+    fastText_->setEventLog(std::make_shared<EventLog>(autotuneArgs.events));
+  }
+  events_ = fastText_->getEventLog();
 
   bool sizeConstraintWarning = false;
   int verbose = autotuneArgs.verbose;
@@ -446,6 +490,13 @@ void Autotune::train(const Args& autotuneArgs) {
     }
     LOG_VAL_NAN(currentScore, currentScore)
     LOG_VAL(train took, elapsedTimeMarker.getElapsed())
+    if (events_) {
+      writeTrialEvent(
+          "autotuneTrial",
+          trainArgs,
+          currentScore,
+          elapsedTimeMarker.getElapsed());
+    }
   }
   if (timer_.joinable()) {
     timer_.join();
@@ -469,8 +520,16 @@ void Autotune::train(const Args& autotuneArgs) {
     bestTrainArgs.verbose = verbose;
     LOG_VAL(Best selected args, 0)
     printArgs(bestTrainArgs, autotuneArgs);
+    ElapsedTimeMarker elapsedTimeMarker;
     fastText_->train(bestTrainArgs);
     quantize(bestTrainArgs, autotuneArgs);
+    if (events_) {
+      writeTrialEvent(
+          "autotuneBest",
+          bestTrainArgs,
+          bestScore_,
+          elapsedTimeMarker.getElapsed());
+    }
   }
 }
 
@@ -50,12 +50,15 @@ class Autotune {
   std::atomic<bool> continueTraining_;
   std::unique_ptr<AutotuneStrategy> strategy_;
   std::thread timer_;
+  // the event log of fastText_, with -events
+  std::shared_ptr<EventLog> events_;
 
   bool keepTraining(double maxDuration) const;
   void printInfo(double maxDuration);
   void timer(
       const std::chrono::steady_clock::time_point& start,
-      double maxDuration);
+      double maxDuration,
+      int32_t eventInterval);
   void abort();
   void startTimer(const Args& args);
   double getMetricScore(
@@ -64,6 +67,11 @@ class Autotune {
       const double metricValue,
       const std::string& metricLabel) const;
   void printArgs(const Args& args, const Args& autotuneArgs);
+  void writeTrialEvent(
+      const std::string& type,
+      const Args& args,
+      double score,
+      double seconds);
   void printSkippedArgs(const Args& autotuneArgs);
   bool quantize(Args& args, const Args& autotuneArgs);
   int getCutoffForFileSize(bool qout, bool qnorm, int dsub, int64_t fileSize)
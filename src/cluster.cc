@@ -0,0 +1,310 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "cluster.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <thread>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+namespace fasttext {
+
+namespace {
+
+// Parameters are averaged by chunks, each process waiting for the average
+// of a chunk before sending the next one.
+constexpr int64_t kChunkSize = 1 << 18;
+constexpr int kConnectTimeout = 120;
+
+} // namespace
+
+Cluster::Cluster(const std::string& coordinator, int32_t rank, int32_t nodes)
+    : rank_(rank), nodes_(nodes), buffer_(kChunkSize) {
+  if (rank < 0 || rank >= nodes) {
+    throw std::invalid_argument(
+        "Rank " + std::to_string(rank) + " is not in [0, " +
+        std::to_string(nodes) + ")!");
+  }
+  size_t colon = coordinator.rfind(':');
+  if (colon == std::string::npos) {
+    throw std::invalid_argument(
+        "Coordinator " + coordinator + " is not of the form host:port!");
+  }
+  std::string host = coordinator.substr(0, colon);
+  std::string port = coordinator.substr(colon + 1);
+  if (rank_ == 0) {
+    listen(host, port);
+  } else {
+    connect(host, port);
+  }
+}
+
+Cluster::~Cluster() {
+#ifndef _WIN32
+  for (int socket : sockets_) {
+    ::close(socket);
+  }
+#endif
+}
+
+#ifdef _WIN32
+
+void Cluster::listen(const std::string&, const std::string&) {
+  throw Error("Distributed training is not supported on Windows!");
+}
+
+void Cluster::connect(const std::string&, const std::string&) {
+  throw Error("Distributed training is not supported on Windows!");
+}
+
+void Cluster::send(int, const void*, int64_t) {}
+
+void Cluster::receive(int, void*, int64_t) {}
+
+#else
+
+void Cluster::listen(const std::string& host, const std::string& port) {
+  struct addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  struct addrinfo* address;
+  if (getaddrinfo(
+          host.empty() ? nullptr : host.c_str(),
+          port.c_str(),
+          &hints,
+          &address) != 0) {
+    throw Error("Cannot resolve " + host + ":" + port + "!");
+  }
+  int server =
+      socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+  int one = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  bool bound = server >= 0 &&
+      bind(server, address->ai_addr, address->ai_addrlen) == 0 &&
+      ::listen(server, nodes_) == 0;
+  freeaddrinfo(address);
+  if (!bound) {
+    if (server >= 0) {
+      ::close(server);
+    }
+    throw Error("Cannot listen on " + host + ":" + port + "!");
+  }
+  sockets_.assign(nodes_ - 1, -1);
+  for (int32_t i = 1; i < nodes_; i++) {
+    int client = accept(server, nullptr, nullptr);
+    int32_t rank = -1;
+    if (client >= 0) {
+      setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      if (recv(client, &rank, sizeof(rank), MSG_WAITALL) != sizeof(rank)) {
+        rank = -1;
+      }
+    }
+    if (rank <= 0 || rank >= nodes_ || sockets_[rank - 1] >= 0) {
+      ::close(server);
+      if (client >= 0) {
+        ::close(client);
+      }
+      throw Error("Invalid connection to the coordinator!");
+    }
+    sockets_[rank - 1] = client;
+  }
+  ::close(server);
+}
+
+// Process 0 may start after the others, so connections are retried.
+void Cluster::connect(const std::string& host, const std::string& port) {
+  struct addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  auto start = std::chrono::steady_clock::now();
+  while (true) {
+    struct addrinfo* address;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &address) == 0) {
+      int client = socket(
+          address->ai_family, address->ai_socktype, address->ai_protocol);
+      bool connected = client >= 0 &&
+          ::connect(client, address->ai_addr, address->ai_addrlen) == 0;
+      freeaddrinfo(address);
+      if (connected) {
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sockets_.push_back(client);
+        send(client, &rank_, sizeof(rank_));
+        return;
+      }
+      if (client >= 0) {
+        ::close(client);
+      }
+    }
+    if (std::chrono::steady_clock::now() - start >
+        std::chrono::seconds(kConnectTimeout)) {
+      throw Error("Cannot connect to the coordinator " + host + ":" + port);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  }
+}
+
+void Cluster::send(int socket, const void* data, int64_t size) {
+  const char* p = (const char*)data;
+  while (size > 0) {
+    ssize_t n = ::send(socket, p, size, MSG_NOSIGNAL);
+    if (n <= 0) {
+      throw Error("Lost the connection to another training process!");
+    }
+    p += n;
+    size -= n;
+  }
+}
+
+void Cluster::receive(int socket, void* data, int64_t size) {
+  char* p = (char*)data;
+  while (size > 0) {
+    ssize_t n = recv(socket, p, size, 0);
+    if (n <= 0) {
+      throw Error("Lost the connection to another training process!");
+    }
+    p += n;
+    size -= n;
+  }
+}
+
+#endif
+
+void Cluster::check(int64_t value, const std::string& what) {
+  int8_t same = 1;
+  if (rank_ == 0) {
+    for (int socket : sockets_) {
+      int64_t other;
+      receive(socket, &other, sizeof(other));
+      same = same && other == value;
+    }
+    for (int socket : sockets_) {
+      send(socket, &same, sizeof(same));
+    }
+  } else {
+    send(sockets_[0], &value, sizeof(value));
+    receive(sockets_[0], &same, sizeof(same));
+  }
+  if (!same) {
+    throw Error("Training processes do not agree on the " + what + "!");
+  }
+}
+
+void Cluster::average(real* data, int64_t size) {
+  std::vector<real> sum(rank_ == 0 ? std::min(kChunkSize, size) : 0);
+  for (int64_t begin = 0; begin < size; begin += kChunkSize) {
+    int64_t n = std::min(kChunkSize, size - begin);
+    real* chunk = data + begin;
+    if (rank_ == 0) {
+      std::copy(chunk, chunk + n, sum.begin());
+      for (int socket : sockets_) {
+        receive(socket, buffer_.data(), n * sizeof(real));
+        for (int64_t i = 0; i < n; i++) {
+          sum[i] += buffer_[i];
+        }
+      }
+      for (int64_t i = 0; i < n; i++) {
+        chunk[i] = sum[i] / nodes_;
+      }
+      for (int socket : sockets_) {
+        send(socket, chunk, n * sizeof(real));
+      }
+    } else {
+      send(sockets_[0], chunk, n * sizeof(real));
+      receive(sockets_[0], chunk, n * sizeof(real));
+    }
+  }
+}
+
+void Cluster::sendRows(
+    int socket,
+    const std::vector<int32_t>& rows,
+    const std::vector<real>& values) {
+  int64_t size = rows.size();
+  send(socket, &size, sizeof(size));
+  send(socket, rows.data(), size * sizeof(int32_t));
+  send(socket, values.data(), values.size() * sizeof(real));
+}
+
+void Cluster::receiveRows(
+    int socket,
+    int64_t dim,
+    std::vector<int32_t>& rows,
+    std::vector<real>& values) {
+  int64_t size;
+  receive(socket, &size, sizeof(size));
+  rows.resize(size);
+  values.resize(size * dim);
+  receive(socket, rows.data(), size * sizeof(int32_t));
+  receive(socket, values.data(), values.size() * sizeof(real));
+}
+
+void Cluster::averageRows(
+    const std::vector<int32_t>& rows,
+    const std::vector<real>& values,
+    int64_t dim,
+    std::vector<int32_t>& allRows,
+    std::vector<real>& averages) {
+  if (rank_ != 0) {
+    sendRows(sockets_[0], rows, values);
+    receiveRows(sockets_[0], dim, allRows, averages);
+    return;
+  }
+  // row -> index of its sum
+  std::map<int32_t, int64_t> index;
+  std::vector<real> sums;
+  auto add = [&](const std::vector<int32_t>& r, const std::vector<real>& v) {
+    for (size_t i = 0; i < r.size(); i++) {
+      auto it = index.insert({r[i], int64_t(index.size())}).first;
+      if (it->second * dim == int64_t(sums.size())) {
+        sums.resize(sums.size() + dim, 0.0);
+      }
+      real* sum = sums.data() + it->second * dim;
+      for (int64_t j = 0; j < dim; j++) {
+        sum[j] += v[i * dim + j];
+      }
+    }
+  };
+  add(rows, values);
+  std::vector<int32_t> otherRows;
+  std::vector<real> otherValues;
+  for (int socket : sockets_) {
+    receiveRows(socket, dim, otherRows, otherValues);
+    add(otherRows, otherValues);
+  }
+  allRows.clear();
+  averages.resize(sums.size());
+  real* average = averages.data();
+  for (const auto& pair : index) {
+    allRows.push_back(pair.first);
+    const real* sum = sums.data() + pair.second * dim;
+    for (int64_t j = 0; j < dim; j++) {
+      average[j] = sum[j] / nodes_;
+    }
+    average += dim;
+  }
+  for (int socket : sockets_) {
+    sendRows(socket, allRows, averages);
+  }
+}
+
+} // namespace fasttext
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "real.h"
+
+namespace fasttext {
+
+// Processes training the same model over TCP. Process 0 listens on the
+// coordinator address ("host:port"), the others connect to it, and
+// collective operations go through process 0. Every process must call the
+// collective operations in the same order.
+class Cluster {
+ protected:
+  int32_t rank_;
+  int32_t nodes_;
+  // on process 0, the socket of process i + 1; elsewhere, the socket of
+  // process 0
+  std::vector<int> sockets_;
+  std::vector<real> buffer_;
+
+  void listen(const std::string& host, const std::string& port);
+  void connect(const std::string& host, const std::string& port);
+  void send(int, const void*, int64_t);
+  void receive(int, void*, int64_t);
+  void sendRows(int, const std::vector<int32_t>&, const std::vector<real>&);
+  void receiveRows(
+      int,
+      int64_t dim,
+      std::vector<int32_t>&,
+      std::vector<real>&);
+
+ public:
+  class Error : public std::runtime_error {
+   public:
+    explicit Error(const std::string& message)
+        : std::runtime_error(message) {}
+  };
+
+  Cluster(const std::string& coordinator, int32_t rank, int32_t nodes);
+  Cluster(const Cluster&) = delete;
+  Cluster& operator=(const Cluster&) = delete;
+  ~Cluster();
+
+  int32_t rank() const {
+    return rank_;
+  }
+  int32_t nodes() const {
+    return nodes_;
+  }
+
+  // Throws on every process unless all of them pass the same value.
+  void check(int64_t value, const std::string& what);
+  // Replaces data by its average over the processes.
+  void average(real* data, int64_t size);
+  // Averages sparse rows of `dim` values over the processes, a missing row
+  // counting as zero. The returned `allRows`, the union of the rows of all
+  // the processes, are increasing.
+  void averageRows(
+      const std::vector<int32_t>& rows,
+      const std::vector<real>& values,
+      int64_t dim,
+      std::vector<int32_t>& allRows,
+      std::vector<real>& averages);
+};
+
+} // namespace fasttext
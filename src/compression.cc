@@ -0,0 +1,498 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "compression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace fasttext {
+
+namespace compression {
+
+namespace {
+
+enum class block_method : uint8_t { stored = 0, lz, huffman };
+
+constexpr int64_t kMaxBlockSize = 1 << 16;
+constexpr int32_t kMinMatch = 4;
+constexpr int32_t kHashBits = 14;
+constexpr int32_t kMaxCodeLength = 11;
+constexpr int32_t kCodeLengthsSize = 128; // 256 lengths of 4 bits
+
+void corrupted() {
+  throw std::invalid_argument("Corrupted compressed model section.");
+}
+
+inline uint32_t read32(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// LZ77 with the sequence layout of LZ4: a token holding the number of
+// literals and the match length in 4 bits each, longer values continued on
+// bytes of 255, the literals, then a 16 bits offset. The last sequence only
+// has literals.
+uint8_t* writeLength(uint8_t* op, int64_t length) {
+  for (; length >= 255; length -= 255) {
+    *op++ = 255;
+  }
+  *op++ = uint8_t(length);
+  return op;
+}
+
+uint8_t* writeSequence(
+    uint8_t* op,
+    const uint8_t* literals,
+    int64_t nliterals,
+    int64_t offset,
+    int64_t length) {
+  uint8_t* token = op++;
+  *token = uint8_t(std::min<int64_t>(nliterals, 15) << 4);
+  if (nliterals >= 15) {
+    op = writeLength(op, nliterals - 15);
+  }
+  std::memcpy(op, literals, nliterals);
+  op += nliterals;
+  if (length == 0) {
+    return op;
+  }
+  *op++ = uint8_t(offset);
+  *op++ = uint8_t(offset >> 8);
+  *token |= uint8_t(std::min<int64_t>(length - kMinMatch, 15));
+  if (length - kMinMatch >= 15) {
+    op = writeLength(op, length - kMinMatch - 15);
+  }
+  return op;
+}
+
+int64_t lzCompress(const uint8_t* src, int64_t size, uint8_t* dst) {
+  std::vector<int32_t> table(1 << kHashBits, -1);
+  uint8_t* op = dst;
+  int64_t anchor = 0;
+  int64_t i = 0;
+  while (i + kMinMatch <= size) {
+    uint32_t v = read32(src + i);
+    uint32_t h = (v * 2654435761u) >> (32 - kHashBits);
+    int64_t candidate = table[h];
+    table[h] = int32_t(i);
+    if (candidate < 0 || read32(src + candidate) != v) {
+      // skip faster through incompressible data
+      i += 1 + ((i - anchor) >> 6);
+      continue;
+    }
+    int64_t length = kMinMatch;
+    while (i + length < size && src[candidate + length] == src[i + length]) {
+      length++;
+    }
+    op = writeSequence(op, src + anchor, i - anchor, i - candidate, length);
+    i += length;
+    anchor = i;
+  }
+  op = writeSequence(op, src + anchor, size - anchor, 0, 0);
+  return op - dst;
+}
+
+int64_t readLength(const uint8_t*& ip, const uint8_t* end) {
+  int64_t length = 0;
+  uint8_t b;
+  do {
+    if (ip == end) {
+      corrupted();
+    }
+    b = *ip++;
+    length += b;
+  } while (b == 255);
+  return length;
+}
+
+void lzDecompress(
+    const uint8_t* ip,
+    const uint8_t* end,
+    uint8_t* dst,
+    int64_t dstSize) {
+  uint8_t* op = dst;
+  uint8_t* opEnd = dst + dstSize;
+  while (true) {
+    if (ip == end) {
+      corrupted();
+    }
+    uint8_t token = *ip++;
+    int64_t nliterals = token >> 4;
+    if (nliterals == 15) {
+      nliterals += readLength(ip, end);
+    }
+    if (nliterals > end - ip || nliterals > opEnd - op) {
+      corrupted();
+    }
+    std::memcpy(op, ip, nliterals);
+    ip += nliterals;
+    op += nliterals;
+    if (ip == end) {
+      break;
+    }
+    if (end - ip < 2) {
+      corrupted();
+    }
+    int64_t offset = ip[0] | (int64_t(ip[1]) << 8);
+    ip += 2;
+    int64_t length = (token & 15) + kMinMatch;
+    if ((token & 15) == 15) {
+      length += readLength(ip, end);
+    }
+    if (offset == 0 || offset > op - dst || length > opEnd - op) {
+      corrupted();
+    }
+    const uint8_t* match = op - offset;
+    if (offset >= length) {
+      std::memcpy(op, match, length);
+      op += length;
+    } else {
+      for (int64_t j = 0; j < length; j++) {
+        *op++ = *match++;
+      }
+    }
+  }
+  if (op != opEnd) {
+    corrupted();
+  }
+}
+
+// Canonical Huffman code with lengths limited to kMaxCodeLength, so that
+// symbols are decoded with a single table lookup.
+void huffmanLengths(const int64_t* counts, uint8_t* lengths) {
+  std::vector<std::pair<int64_t, int32_t>> leaves;
+  for (int32_t s = 0; s < 256; s++) {
+    lengths[s] = 0;
+    if (counts[s] > 0) {
+      leaves.emplace_back(counts[s], s);
+    }
+  }
+  if (leaves.empty()) {
+    return;
+  }
+  if (leaves.size() == 1) {
+    lengths[leaves[0].second] = 1;
+    return;
+  }
+  std::sort(leaves.begin(), leaves.end());
+
+  // two queues construction: leaves and internal nodes are both sorted
+  int32_t n = leaves.size();
+  std::vector<int64_t> weight(2 * n - 1);
+  std::vector<int32_t> parent(2 * n - 1, -1);
+  for (int32_t i = 0; i < n; i++) {
+    weight[i] = leaves[i].first;
+  }
+  int32_t leaf = 0;
+  int32_t node = n;
+  int32_t next = n;
+  auto pop = [&]() {
+    if (leaf < n && (node == next || weight[leaf] <= weight[node])) {
+      return leaf++;
+    }
+    return node++;
+  };
+  for (; next < 2 * n - 1; next++) {
+    int32_t a = pop();
+    int32_t b = pop();
+    weight[next] = weight[a] + weight[b];
+    parent[a] = next;
+    parent[b] = next;
+  }
+  std::vector<int32_t> depth(2 * n - 1, 0);
+  for (int32_t i = 2 * n - 3; i >= 0; i--) {
+    depth[i] = depth[parent[i]] + 1;
+  }
+
+  // limit the lengths, then lengthen the least frequent codes until the
+  // Kraft inequality holds again
+  int64_t kraft = 0;
+  for (int32_t i = 0; i < n; i++) {
+    depth[i] = std::min(depth[i], kMaxCodeLength);
+    kraft += int64_t(1) << (kMaxCodeLength - depth[i]);
+  }
+  while (kraft > (int64_t(1) << kMaxCodeLength)) {
+    for (int32_t i = 0; i < n; i++) {
+      if (depth[i] < kMaxCodeLength) {
+        depth[i]++;
+        kraft -= int64_t(1) << (kMaxCodeLength - depth[i]);
+        break;
+      }
+    }
+  }
+  for (int32_t i = 0; i < n; i++) {
+    lengths[leaves[i].second] = uint8_t(depth[i]);
+  }
+}
+
+// Codes are stored bit reversed, as the stream is read from the lowest bit.
+void huffmanCodes(const uint8_t* lengths, uint16_t* codes) {
+  int32_t lengthCount[kMaxCodeLength + 1] = {0};
+  for (int32_t s = 0; s < 256; s++) {
+    lengthCount[lengths[s]]++;
+  }
+  lengthCount[0] = 0;
+  int32_t nextCode[kMaxCodeLength + 1] = {0};
+  int32_t code = 0;
+  for (int32_t l = 1; l <= kMaxCodeLength; l++) {
+    code = (code + lengthCount[l - 1]) << 1;
+    nextCode[l] = code;
+  }
+  for (int32_t s = 0; s < 256; s++) {
+    int32_t l = lengths[s];
+    if (l == 0) {
+      continue;
+    }
+    int32_t c = nextCode[l]++;
+    uint16_t reversed = 0;
+    for (int32_t j = 0; j < l; j++) {
+      reversed |= ((c >> j) & 1) << (l - 1 - j);
+    }
+    codes[s] = reversed;
+  }
+}
+
+int64_t huffmanSize(const int64_t* counts, const uint8_t* lengths) {
+  int64_t bits = 0;
+  for (int32_t s = 0; s < 256; s++) {
+    bits += counts[s] * lengths[s];
+  }
+  return kCodeLengthsSize + (bits + 7) / 8;
+}
+
+int64_t huffmanCompress(
+    const uint8_t* src,
+    int64_t size,
+    const uint8_t* lengths,
+    uint8_t* dst) {
+  uint16_t codes[256];
+  huffmanCodes(lengths, codes);
+  uint8_t* op = dst;
+  for (int32_t s = 0; s < 256; s += 2) {
+    *op++ = uint8_t(lengths[s] | (lengths[s + 1] << 4));
+  }
+  uint64_t buffer = 0;
+  int32_t nbits = 0;
+  for (int64_t i = 0; i < size; i++) {
+    buffer |= uint64_t(codes[src[i]]) << nbits;
+    nbits += lengths[src[i]];
+    while (nbits >= 8) {
+      *op++ = uint8_t(buffer);
+      buffer >>= 8;
+      nbits -= 8;
+    }
+  }
+  if (nbits > 0) {
+    *op++ = uint8_t(buffer);
+  }
+  return op - dst;
+}
+
+void huffmanDecompress(
+    const uint8_t* ip,
+    const uint8_t* end,
+    uint8_t* dst,
+    int64_t dstSize) {
+  if (end - ip < kCodeLengthsSize) {
+    corrupted();
+  }
+  uint8_t lengths[256];
+  for (int32_t s = 0; s < 256; s += 2) {
+    lengths[s] = *ip & 15;
+    lengths[s + 1] = *ip >> 4;
+    ip++;
+  }
+  int64_t kraft = 0;
+  for (int32_t s = 0; s < 256; s++) {
+    if (lengths[s] > kMaxCodeLength) {
+      corrupted();
+    }
+    if (lengths[s] > 0) {
+      kraft += int64_t(1) << (kMaxCodeLength - lengths[s]);
+    }
+  }
+  if (kraft > (int64_t(1) << kMaxCodeLength)) {
+    corrupted();
+  }
+  uint16_t codes[256];
+  huffmanCodes(lengths, codes);
+  // entries hold the symbol in the low byte and the code length above
+  std::vector<uint16_t> table(1 << kMaxCodeLength, 0);
+  for (int32_t s = 0; s < 256; s++) {
+    int32_t l = lengths[s];
+    if (l == 0) {
+      continue;
+    }
+    for (int32_t j = codes[s]; j < (1 << kMaxCodeLength); j += (1 << l)) {
+      table[j] = uint16_t(s | (l << 8));
+    }
+  }
+
+  uint64_t buffer = 0;
+  int32_t nbits = 0;
+  const uint16_t mask = (1 << kMaxCodeLength) - 1;
+  int64_t i = 0;
+  // a refill of 8 bytes leaves at least 56 bits, enough for 5 symbols
+  for (; i + 5 <= dstSize && end - ip >= 8; i += 5) {
+    uint64_t bytes;
+    std::memcpy(&bytes, ip, sizeof(bytes));
+    buffer |= bytes << nbits;
+    ip += (63 - nbits) >> 3;
+    nbits |= 56;
+    for (int32_t j = 0; j < 5; j++) {
+      uint16_t entry = table[buffer & mask];
+      int32_t l = entry >> 8;
+      if (l == 0) {
+        corrupted();
+      }
+      dst[i + j] = uint8_t(entry);
+      buffer >>= l;
+      nbits -= l;
+    }
+  }
+  for (; i < dstSize; i++) {
+    while (nbits <= 56 && ip < end) {
+      buffer |= uint64_t(*ip++) << nbits;
+      nbits += 8;
+    }
+    uint16_t entry = table[buffer & mask];
+    int32_t l = entry >> 8;
+    if (l == 0 || l > nbits) {
+      corrupted();
+    }
+    dst[i] = uint8_t(entry);
+    buffer >>= l;
+    nbits -= l;
+  }
+  if (ip != end || nbits >= 8) {
+    corrupted();
+  }
+}
+
+} // namespace
+
+void shuffle(const char* src, int64_t size, int32_t stride, char* dst) {
+  int64_t i = 0;
+  if (stride == 4) {
+    int64_t n = size / 4;
+    char* planes[4] = {dst, dst + (size + 3) / 4, nullptr, nullptr};
+    planes[2] = planes[1] + (size + 2) / 4;
+    planes[3] = planes[2] + (size + 1) / 4;
+    for (; i < n; i++) {
+      planes[0][i] = src[4 * i];
+      planes[1][i] = src[4 * i + 1];
+      planes[2][i] = src[4 * i + 2];
+      planes[3][i] = src[4 * i + 3];
+    }
+    for (int32_t j = 0; 4 * i + j < size; j++) {
+      planes[j][i] = src[4 * i + j];
+    }
+    return;
+  }
+  for (int32_t j = 0; j < stride; j++) {
+    for (i = j; i < size; i += stride) {
+      *dst++ = src[i];
+    }
+  }
+}
+
+void unshuffle(const char* src, int64_t size, int32_t stride, char* dst) {
+  int64_t i = 0;
+  if (stride == 4) {
+    int64_t n = size / 4;
+    const char* planes[4] = {src, src + (size + 3) / 4, nullptr, nullptr};
+    planes[2] = planes[1] + (size + 2) / 4;
+    planes[3] = planes[2] + (size + 1) / 4;
+    for (; i < n; i++) {
+      dst[4 * i] = planes[0][i];
+      dst[4 * i + 1] = planes[1][i];
+      dst[4 * i + 2] = planes[2][i];
+      dst[4 * i + 3] = planes[3][i];
+    }
+    for (int32_t j = 0; 4 * i + j < size; j++) {
+      dst[4 * i + j] = planes[j][i];
+    }
+    return;
+  }
+  for (int32_t j = 0; j < stride; j++) {
+    for (i = j; i < size; i += stride) {
+      dst[i] = *src++;
+    }
+  }
+}
+
+int64_t compressBound(int64_t size) {
+  return 1 + size + size / 255 + 16;
+}
+
+int64_t compressBlock(const char* src, int64_t size, char* dst) {
+  if (size > kMaxBlockSize) {
+    throw std::invalid_argument("Compressed blocks are limited to 64KB.");
+  }
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+
+  std::vector<uint8_t> lz(compressBound(size));
+  int64_t lzSize = lzCompress(in, size, lz.data());
+
+  int64_t counts[256] = {0};
+  for (int64_t i = 0; i < size; i++) {
+    counts[in[i]]++;
+  }
+  uint8_t lengths[256];
+  huffmanLengths(counts, lengths);
+  int64_t huffmanBound = huffmanSize(counts, lengths);
+
+  if (huffmanBound < lzSize && huffmanBound < size) {
+    out[0] = uint8_t(block_method::huffman);
+    return 1 + huffmanCompress(in, size, lengths, out + 1);
+  }
+  if (lzSize < size) {
+    out[0] = uint8_t(block_method::lz);
+    std::memcpy(out + 1, lz.data(), lzSize);
+    return 1 + lzSize;
+  }
+  out[0] = uint8_t(block_method::stored);
+  std::memcpy(out + 1, in, size);
+  return 1 + size;
+}
+
+void decompressBlock(
+    const char* src,
+    int64_t size,
+    char* dst,
+    int64_t dstSize) {
+  if (size < 1) {
+    corrupted();
+  }
+  const uint8_t* ip = (const uint8_t*)src + 1;
+  const uint8_t* end = (const uint8_t*)src + size;
+  uint8_t* out = (uint8_t*)dst;
+  block_method method = block_method(uint8_t(src[0]));
+  if (method == block_method::stored) {
+    if (end - ip != dstSize) {
+      corrupted();
+    }
+    std::memcpy(out, ip, dstSize);
+  } else if (method == block_method::lz) {
+    lzDecompress(ip, end, out, dstSize);
+  } else if (method == block_method::huffman) {
+    huffmanDecompress(ip, end, out, dstSize);
+  } else {
+    corrupted();
+  }
+}
+
+} // namespace compression
+
+} // namespace fasttext
@@ -0,0 +1,42 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace fasttext {
+
+namespace compression {
+
+// Gathers byte j of every `stride` bytes into the j-th plane of `dst`, so
+// that the similar bytes of floating point values (sign and exponent) end
+// up next to each other. `size` needs not be a multiple of `stride`.
+void shuffle(const char* src, int64_t size, int32_t stride, char* dst);
+
+void unshuffle(const char* src, int64_t size, int32_t stride, char* dst);
+
+// Maximal size of a compressed block of `size` bytes.
+int64_t compressBound(int64_t size);
+
+// Compresses a block of at most 64KB with whichever of LZ, Huffman coding
+// or raw storage is the smallest. Returns the size written to `dst`, which
+// must hold compressBound(size) bytes.
+int64_t compressBlock(const char* src, int64_t size, char* dst);
+
+// Decompresses a block produced by compressBlock. Throws if the block is
+// corrupted or does not decompress to exactly `dstSize` bytes.
+void decompressBlock(
+    const char* src,
+    int64_t size,
+    char* dst,
+    int64_t dstSize);
+
+} // namespace compression
+
+} // namespace fasttext
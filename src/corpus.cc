@@ -0,0 +1,267 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "corpus.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+
+namespace fasttext {
+
+namespace {
+
+// Words are spelled with syllables of a consonant and a vowel.
+struct Script {
+  std::vector<uint32_t> consonants;
+  std::vector<uint32_t> vowels;
+};
+
+const Script kLatin = {
+    {'b', 'c', 'd', 'f', 'g', 'h', 'j', 'k', 'l',
+     'm', 'n', 'p', 'r', 's', 't', 'v', 'z'},
+    {'a', 'e', 'i', 'o', 'u'}};
+const Script kCyrillic = {
+    {0x0431, 0x0432, 0x0433, 0x0434, 0x0437, 0x043a, 0x043b,
+     0x043c, 0x043d, 0x043f, 0x0440, 0x0441, 0x0442, 0x0444},
+    {0x0430, 0x0435, 0x0438, 0x043e, 0x0443, 0x044f}};
+const Script kGreek = {
+    {0x03b2, 0x03b3, 0x03b4, 0x03b6, 0x03b8, 0x03ba, 0x03bb, 0x03bc,
+     0x03bd, 0x03c0, 0x03c1, 0x03c3, 0x03c4, 0x03c6, 0x03c7},
+    {0x03b1, 0x03b5, 0x03b7, 0x03b9, 0x03bf, 0x03c9}};
+// CJK words are spelled with the first ideographs of the Unicode block.
+const uint32_t kFirstIdeograph = 0x4e00;
+const int32_t kIdeographs = 2048;
+
+uint32_t mix(uint32_t x) {
+  return (x + 1) * 2654435761u;
+}
+
+void appendUtf8(std::string& out, uint32_t c) {
+  if (c < 0x80) {
+    out.push_back(c);
+  } else if (c < 0x800) {
+    out.push_back(0xc0 | (c >> 6));
+    out.push_back(0x80 | (c & 0x3f));
+  } else if (c < 0x10000) {
+    out.push_back(0xe0 | (c >> 12));
+    out.push_back(0x80 | ((c >> 6) & 0x3f));
+    out.push_back(0x80 | (c & 0x3f));
+  } else {
+    out.push_back(0xf0 | (c >> 18));
+    out.push_back(0x80 | ((c >> 12) & 0x3f));
+    out.push_back(0x80 | ((c >> 6) & 0x3f));
+    out.push_back(0x80 | (c & 0x3f));
+  }
+}
+
+// Calls emit with the digits of n in bijective base k, so that different
+// numbers have different spellings, the small ones being the shortest.
+template <typename Emit>
+void spell(int64_t n, int32_t k, Emit emit) {
+  do {
+    emit(n % k);
+    n = n / k - 1;
+  } while (n >= 0);
+}
+
+void appendSyllables(std::string& out, int64_t n, const Script& script) {
+  const int32_t vowels = script.vowels.size();
+  spell(n, script.consonants.size() * vowels, [&](int32_t d) {
+    appendUtf8(out, script.consonants[d / vowels]);
+    appendUtf8(out, script.vowels[d % vowels]);
+  });
+}
+
+std::vector<double> zipfWeights(int32_t n, double exponent) {
+  std::vector<double> weights(n);
+  for (int32_t i = 0; i < n; i++) {
+    weights[i] = std::pow(i + 1.0, -exponent);
+  }
+  return weights;
+}
+
+} // namespace
+
+CorpusOptions::CorpusOptions()
+    : words(100000),
+      zipf(1.0),
+      labels(100),
+      labelsPerLine(1),
+      labelZipf(1.0),
+      label("__label__"),
+      topic(0.2),
+      meanLength(20.0),
+      lengthSigma(0.8),
+      maxLength(1000),
+      utf8(0.1),
+      seed(0) {}
+
+AliasTable::AliasTable(const std::vector<double>& weights)
+    : probabilities_(weights.size()), aliases_(weights.size()) {
+  const int32_t n = weights.size();
+  double sum = 0.0;
+  for (double weight : weights) {
+    sum += weight;
+  }
+  std::vector<int32_t> small, large;
+  for (int32_t i = 0; i < n; i++) {
+    probabilities_[i] = weights[i] * n / sum;
+    aliases_[i] = i;
+    (probabilities_[i] < 1.0 ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    int32_t s = small.back();
+    int32_t l = large.back();
+    small.pop_back();
+    aliases_[s] = l;
+    probabilities_[l] -= 1.0 - probabilities_[s];
+    if (probabilities_[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+  // what remains is 1 up to rounding errors
+  for (int32_t i : small) {
+    probabilities_[i] = 1.0;
+  }
+  for (int32_t i : large) {
+    probabilities_[i] = 1.0;
+  }
+}
+
+int32_t AliasTable::sample(std::minstd_rand& rng) const {
+  std::uniform_int_distribution<int32_t> column(0, probabilities_.size() - 1);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  int32_t i = column(rng);
+  return uniform(rng) < probabilities_[i] ? i : aliases_[i];
+}
+
+CorpusGenerator::CorpusGenerator(const CorpusOptions& options)
+    : options_(options),
+      words_(zipfWeights(options.words, options.zipf)),
+      labels_(zipfWeights(options.labels, options.labelZipf)),
+      rng_(options.seed),
+      length_(
+          std::log(std::max(options.meanLength, 1.0)) -
+              options.lengthSigma * options.lengthSigma / 2,
+          options.lengthSigma > 0 ? options.lengthSigma : 1.0),
+      uniform_(0.0, 1.0) {
+  if (options_.words <= 0) {
+    throw std::invalid_argument("The vocabulary of a corpus can't be empty!");
+  }
+  if (options_.labels < 0 || options_.maxLength <= 0 ||
+      options_.meanLength < 1.0 || options_.lengthSigma < 0) {
+    throw std::invalid_argument("Invalid corpus options!");
+  }
+  options_.labelsPerLine =
+      std::max(1, std::min(options_.labelsPerLine, options_.labels));
+}
+
+void CorpusGenerator::appendWord(int32_t id) {
+  uint32_t hash = mix(id);
+  if (hash >= options_.utf8 * 4294967296.0) {
+    appendSyllables(line_, id, kLatin);
+  } else if (hash % 3 == 0) {
+    appendSyllables(line_, id, kCyrillic);
+  } else if (hash % 3 == 1) {
+    appendSyllables(line_, id, kGreek);
+  } else {
+    spell(id, kIdeographs, [&](int32_t d) {
+      appendUtf8(line_, kFirstIdeograph + d);
+    });
+  }
+}
+
+void CorpusGenerator::appendLabel(int32_t id) {
+  line_.append(options_.label);
+  line_.append(std::to_string(id));
+}
+
+const std::string& CorpusGenerator::nextLine() {
+  line_.clear();
+  lineLabels_.clear();
+  if (options_.labels > 0) {
+    while (lineLabels_.size() < options_.labelsPerLine) {
+      int32_t label = labels_.sample(rng_);
+      if (std::find(lineLabels_.begin(), lineLabels_.end(), label) ==
+          lineLabels_.end()) {
+        lineLabels_.push_back(label);
+      }
+    }
+    for (int32_t label : lineLabels_) {
+      appendLabel(label);
+      line_.push_back(' ');
+    }
+  }
+  double length = options_.lengthSigma > 0 ? length_(rng_)
+                                           : options_.meanLength;
+  int32_t n = std::max(
+      1, std::min(options_.maxLength, int32_t(std::lround(length))));
+  // the frequent words of a label are shifted in the vocabulary
+  int32_t offset = lineLabels_.empty()
+      ? 0
+      : mix(lineLabels_[0]) % uint32_t(options_.words);
+  for (int32_t i = 0; i < n; i++) {
+    int32_t word = words_.sample(rng_);
+    if (offset > 0 && uniform_(rng_) < options_.topic) {
+      word = (int64_t(word) + offset) % options_.words;
+    }
+    if (i > 0) {
+      line_.push_back(' ');
+    }
+    appendWord(word);
+  }
+  line_.push_back('\n');
+  return line_;
+}
+
+int64_t
+CorpusGenerator::write(std::ostream& out, int64_t lines, int64_t bytes) {
+  int64_t written = 0;
+  if (lines <= 0 && bytes <= 0) {
+    return written;
+  }
+  for (int64_t i = 0; lines <= 0 || i < lines; i++) {
+    if (bytes > 0 && written >= bytes) {
+      break;
+    }
+    const std::string& line = nextLine();
+    out.write(line.data(), line.size());
+    written += line.size();
+  }
+  return written;
+}
+
+int64_t CorpusGenerator::parseSize(const std::string& size) {
+  size_t end = 0;
+  double value = -1;
+  try {
+    value = std::stod(size, &end);
+  } catch (const std::exception&) {
+  }
+  std::string unit = size.substr(end);
+  if (!unit.empty() && (unit.back() == 'B' || unit.back() == 'b')) {
+    unit.pop_back();
+  }
+  size_t power = std::string("KMGT").find(
+      unit.size() == 1 ? std::toupper(unit[0]) : '?');
+  double scale = 1;
+  if (power != std::string::npos) {
+    scale = std::pow(1024.0, power + 1);
+  } else if (!unit.empty()) {
+    value = -1;
+  }
+  if (value < 0) {
+    throw std::invalid_argument("Invalid size " + size + "!");
+  }
+  return value * scale;
+}
+
+} // namespace fasttext
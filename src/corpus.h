@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fasttext {
+
+struct CorpusOptions {
+  // vocabulary size, and exponent of the word frequencies by rank
+  int32_t words;
+  double zipf;
+  // no labels for an unsupervised corpus
+  int32_t labels;
+  int32_t labelsPerLine;
+  double labelZipf;
+  std::string label;
+  // probability that a word is drawn from the vocabulary of the first label
+  // of its line, whose frequent words differ from the other labels
+  double topic;
+  // words by line follow a log-normal distribution, fixed if lengthSigma is 0
+  double meanLength;
+  double lengthSigma;
+  int32_t maxLength;
+  // fraction of the words spelled in Cyrillic, Greek or CJK characters
+  double utf8;
+  uint32_t seed;
+
+  CorpusOptions();
+};
+
+// Draws from a discrete distribution in constant time (Vose's alias method).
+class AliasTable {
+ protected:
+  std::vector<double> probabilities_;
+  std::vector<int32_t> aliases_;
+
+ public:
+  explicit AliasTable(const std::vector<double>& weights);
+
+  int32_t sample(std::minstd_rand& rng) const;
+};
+
+// Generates lines in the fastText format, reproducibly from the seed.
+class CorpusGenerator {
+ protected:
+  CorpusOptions options_;
+  AliasTable words_;
+  AliasTable labels_;
+  std::minstd_rand rng_;
+  std::lognormal_distribution<double> length_;
+  std::uniform_real_distribution<double> uniform_;
+  std::vector<int32_t> lineLabels_;
+  std::string line_;
+
+  void appendWord(int32_t);
+  void appendLabel(int32_t);
+
+ public:
+  explicit CorpusGenerator(const CorpusOptions& options);
+
+  // Returns the next line, ending with '\n'.
+  const std::string& nextLine();
+  // Writes lines until `lines` lines or `bytes` bytes are written, and
+  // returns the bytes written. A limit of 0 is unset, but not both.
+  int64_t write(std::ostream& out, int64_t lines, int64_t bytes);
+
+  // Parses sizes like "1500", "64K", "1M", "100G", in powers of 1024.
+  static int64_t parseSize(const std::string&);
+};
+
+} // namespace fasttext
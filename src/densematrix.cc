@@ -10,7 +10,6 @@
 
 #include <random>
 #include <stdexcept>
-#include <thread>
 #include <utility>
 #include "utils.h"
 #include "vector.h"
@@ -19,42 +18,52 @@ namespace fasttext {
 
 DenseMatrix::DenseMatrix() : DenseMatrix(0, 0) {}
 
-DenseMatrix::DenseMatrix(int64_t m, int64_t n) : Matrix(m, n), data_(m * n) {}
+DenseMatrix::DenseMatrix(int64_t m, int64_t n)
+    : Matrix(m, n), data_(m * n, 0.0) {}
+
+// Values are left uninitialized, e.g. to be filled in parallel by uniform.
+DenseMatrix::DenseMatrix(int64_t m, int64_t n, Uninitialized)
+    : Matrix(m, n), data_(m * n) {}
 
 DenseMatrix::DenseMatrix(DenseMatrix&& other) noexcept
-    : Matrix(other.m_, other.n_), data_(std::move(other.data_)) {}
+    : Matrix(other.m_, other.n_),
+      data_(std::move(other.data_)),
+      updated_(std::move(other.updated_)) {}
 
 DenseMatrix::DenseMatrix(int64_t m, int64_t n, real* dataPtr)
     : Matrix(m, n), data_(dataPtr, dataPtr + (m * n)) {}
 
-void DenseMatrix::zero() {
-  std::fill(data_.begin(), data_.end(), 0.0);
+void DenseMatrix::trackUpdatedRows(bool track) {
+  updated_.assign(track ? m_ : 0, 0);
 }
 
-void DenseMatrix::uniformThread(real a, int block, int32_t seed) {
-  std::minstd_rand rng(block + seed);
-  std::uniform_real_distribution<> uniform(-a, a);
-  int64_t blockSize = (m_ * n_) / 10;
-  for (int64_t i = blockSize * block;
-       i < (m_ * n_) && i < blockSize * (block + 1);
-       i++) {
-    data_[i] = uniform(rng);
+// Returns the updated rows in increasing order, and clears their flags.
+std::vector<int32_t> DenseMatrix::takeUpdatedRows() {
+  std::vector<int32_t> rows;
+  for (int64_t i = 0; i < int64_t(updated_.size()); i++) {
+    if (updated_[i]) {
+      updated_[i] = 0;
+      rows.push_back(i);
+    }
   }
+  return rows;
+}
+
+void DenseMatrix::zero() {
+  std::fill(data_.begin(), data_.end(), 0.0);
 }
 
 void DenseMatrix::uniform(real a, unsigned int thread, int32_t seed) {
-  if (thread > 1) {
-    std::vector<std::thread> threads;
-    for (int i = 0; i < thread; i++) {
-      threads.push_back(std::thread([=]() { uniformThread(a, i, seed); }));
-    }
-    for (int32_t i = 0; i < threads.size(); i++) {
-      threads[i].join();
-    }
-  } else {
-    // webassembly can't instantiate `std::thread`
-    uniformThread(a, 0, seed);
-  }
+  utils::parallelChunks(
+      m_ * n_,
+      thread,
+      seed,
+      [&](int64_t begin, int64_t end, std::minstd_rand& rng) {
+        std::uniform_real_distribution<> uniform(-a, a);
+        for (int64_t i = begin; i < end; i++) {
+          data_[i] = uniform(rng);
+        }
+      });
 }
 
 void DenseMatrix::multiplyRow(const Vector& nums, int64_t ib, int64_t ie) {
@@ -126,6 +135,9 @@ void DenseMatrix::addVectorToRow(const Vector& vec, int64_t i, real a) {
   for (int64_t j = 0; j < n_; j++) {
     data_[i * n_ + j] += a * vec[j];
   }
+  if (!updated_.empty()) {
+    updated_[i] = 1;
+  }
 }
 
 void DenseMatrix::addRowToVector(Vector& x, int32_t i) const {
@@ -155,7 +167,7 @@ void DenseMatrix::save(std::ostream& out) const {
 void DenseMatrix::load(std::istream& in) {
   in.read((char*)&m_, sizeof(int64_t));
   in.read((char*)&n_, sizeof(int64_t));
-  data_ = std::vector<real>(m_ * n_);
+  data_.resize(m_ * n_);
   in.read((char*)data_.data(), m_ * n_ * sizeof(real));
 }
 
@@ -17,6 +17,7 @@
 
 #include "matrix.h"
 #include "real.h"
+#include "utils.h"
 
 namespace fasttext {
 
@@ -24,12 +25,17 @@ class Vector;
 
 class DenseMatrix : public Matrix {
  protected:
-  std::vector<real> data_;
-  void uniformThread(real, int, int32_t);
+  std::vector<real, utils::DefaultInitAllocator<real>> data_;
+  // rows changed by addVectorToRow since the last takeUpdatedRows, when
+  // tracked. Like the parameters, the flags are written without locks.
+  std::vector<uint8_t> updated_;
 
  public:
+  struct Uninitialized {};
+
   DenseMatrix();
   explicit DenseMatrix(int64_t, int64_t);
+  explicit DenseMatrix(int64_t, int64_t, Uninitialized);
   explicit DenseMatrix(int64_t m, int64_t n, real* dataPtr);
   DenseMatrix(const DenseMatrix&) = default;
   DenseMatrix(DenseMatrix&&) noexcept;
@@ -61,6 +67,9 @@ class DenseMatrix : public Matrix {
   void zero();
   void uniform(real, unsigned int, int32_t);
 
+  void trackUpdatedRows(bool);
+  std::vector<int32_t> takeUpdatedRows();
+
   void multiplyRow(const Vector& nums, int64_t ib = 0, int64_t ie = -1);
   void divideRow(const Vector& denoms, int64_t ib = 0, int64_t ie = -1);
 
@@ -101,6 +101,20 @@ const std::vector<int32_t> Dictionary::getSubwords(
   return ngrams;
 }
 
+void Dictionary::getSubwords(
+    const std::string& word,
+    std::vector<int32_t>& ngrams) const {
+  int32_t i = getId(word);
+  if (i >= 0) {
+    ngrams.assign(words_[i].subwords.cbegin(), words_[i].subwords.cend());
+    return;
+  }
+  ngrams.clear();
+  if (word != EOS) {
+    computeSubwords(BOW + word + EOW, ngrams);
+  }
+}
+
 void Dictionary::getSubwords(
     const std::string& word,
     std::vector<int32_t>& ngrams,
@@ -258,6 +272,57 @@ void Dictionary::readFromFile(std::istream& in) {
   }
 }
 
+// Adds the words and labels of a new corpus, keeping the ids of the words
+// and labels already in the dictionary. New words are inserted after the
+// existing words and new labels after the existing labels, so only label
+// ids shift. Counts of existing entries are increased, and ntokens is set
+// to the size of the new corpus.
+void Dictionary::update(std::istream& in) {
+  Dictionary counts(args_);
+  std::string word;
+  int64_t minThreshold = 1;
+  while (readWord(in, word)) {
+    counts.add(word);
+    if (counts.size_ > 0.75 * MAX_VOCAB_SIZE) {
+      minThreshold++;
+      counts.threshold(minThreshold, minThreshold);
+    }
+  }
+  std::vector<entry> words;
+  std::vector<entry> labels;
+  for (int32_t i = 0; i < counts.size_; i++) {
+    const entry& e = counts.words_[i];
+    int32_t id = getId(e.word);
+    if (id >= 0) {
+      words_[id].count += e.count;
+    } else if (e.type == entry_type::word && e.count >= args_->minCount) {
+      words.push_back(e);
+    } else if (
+        e.type == entry_type::label && e.count >= args_->minCountLabel) {
+      labels.push_back(e);
+    }
+  }
+  words_.insert(words_.begin() + nwords_, words.begin(), words.end());
+  words_.insert(words_.end(), labels.begin(), labels.end());
+  nwords_ += words.size();
+  nlabels_ += labels.size();
+  size_ = nwords_ + nlabels_;
+  ntokens_ = counts.ntokens_;
+
+  int32_t word2intsize = std::ceil(size_ / 0.7);
+  word2int_.assign(word2intsize, -1);
+  for (int32_t i = 0; i < size_; i++) {
+    word2int_[find(words_[i].word)] = i;
+  }
+  initTableDiscard();
+  initNgrams();
+  if (args_->verbose > 0) {
+    std::cerr << "\rRead " << ntokens_ / 1000000 << "M words" << std::endl;
+    std::cerr << "New words:  " << words.size() << std::endl;
+    std::cerr << "New labels: " << labels.size() << std::endl;
+  }
+}
+
 void Dictionary::threshold(int64_t t, int64_t tl) {
   sort(words_.begin(), words_.end(), [](const entry& e1, const entry& e2) {
     if (e1.type != e2.type) {
@@ -381,11 +446,21 @@ int32_t Dictionary::getLine(
     std::vector<int32_t>& labels) const {
   std::vector<int32_t> word_hashes;
   std::string token;
+  return getLine(in, words, labels, word_hashes, token);
+}
+
+int32_t Dictionary::getLine(
+    std::istream& in,
+    std::vector<int32_t>& words,
+    std::vector<int32_t>& labels,
+    std::vector<int32_t>& word_hashes,
+    std::string& token) const {
   int32_t ntokens = 0;
 
   reset(in);
   words.clear();
   labels.clear();
+  word_hashes.clear();
   while (readWord(in, token)) {
     uint32_t h = hash(token);
     int32_t wid = getId(token, h);
@@ -435,13 +510,13 @@ void Dictionary::save(std::ostream& out) const {
   out.write((char*)&ntokens_, sizeof(int64_t));
   out.write((char*)&pruneidx_size_, sizeof(int64_t));
   for (int32_t i = 0; i < size_; i++) {
-    entry e = words_[i];
+    const entry& e = words_[i];
     out.write(e.word.data(), e.word.size() * sizeof(char));
     out.put(0);
     out.write((char*)&(e.count), sizeof(int64_t));
     out.write((char*)&(e.type), sizeof(entry_type));
   }
-  for (const auto pair : pruneidx_) {
+  for (const auto& pair : pruneidx_) {
     out.write((char*)&(pair.first), sizeof(int32_t));
     out.write((char*)&(pair.second), sizeof(int32_t));
   }
@@ -499,10 +574,19 @@ void Dictionary::prune(std::vector<int32_t>& idx) {
   std::sort(words.begin(), words.end());
   idx = words;
 
+  // buckets may already be remapped, in which case the new ids must point
+  // back to the original buckets
+  bool remapped = isPruned();
+  std::unordered_map<int32_t, int32_t> buckets;
+  for (const auto pair : pruneidx_) {
+    buckets[pair.second] = pair.first;
+  }
+  pruneidx_.clear();
   if (ngrams.size() != 0) {
     int32_t j = 0;
     for (const auto ngram : ngrams) {
-      pruneidx_[ngram - nwords_] = j;
+      int32_t id = ngram - nwords_;
+      pruneidx_[remapped ? buckets.at(id) : id] = j;
       j++;
     }
     idx.insert(idx.end(), ngrams.begin(), ngrams.end());
@@ -526,6 +610,59 @@ void Dictionary::prune(std::vector<int32_t>& idx) {
   initNgrams();
 }
 
+// Remaps the hash buckets used by the training data to consecutive ids,
+// so that only these rows of the input matrix need to be allocated.
+// Supervised lines also hash out of vocabulary words and word ngrams, which
+// requires an extra pass over the data.
+void Dictionary::compactBuckets(std::istream& in) {
+  if (isPruned()) {
+    throw std::invalid_argument("Buckets of a pruned dictionary are fixed.");
+  }
+  std::vector<bool> used(args_->bucket, false);
+  for (int32_t i = 0; i < nwords_; i++) {
+    for (const auto id : words_[i].subwords) {
+      if (id >= nwords_) {
+        used[id - nwords_] = true;
+      }
+    }
+  }
+  if (args_->model == model_name::sup) {
+    std::vector<int32_t> line, labels;
+    in.clear();
+    in.seekg(std::streampos(0));
+    while (in.peek() != EOF) {
+      getLine(in, line, labels);
+      for (const auto id : line) {
+        if (id >= nwords_) {
+          used[id - nwords_] = true;
+        }
+      }
+    }
+  }
+  pruneidx_.clear();
+  int32_t j = 0;
+  for (int32_t i = 0; i < args_->bucket; i++) {
+    if (used[i]) {
+      pruneidx_[i] = j++;
+    }
+  }
+  pruneidx_size_ = pruneidx_.size();
+  initNgrams();
+  if (args_->verbose > 0) {
+    std::cerr << "Number of buckets: " << pruneidx_size_ << std::endl;
+  }
+}
+
+int64_t Dictionary::nbuckets() const {
+  return pruneidx_size_ >= 0 ? pruneidx_size_ : args_->bucket;
+}
+
+int32_t Dictionary::getSubwordId(const std::string& subword) const {
+  std::vector<int32_t> ids;
+  pushHash(ids, hash(subword) % args_->bucket);
+  return ids.empty() ? -1 : ids[0];
+}
+
 void Dictionary::dump(std::ostream& out) const {
   out << words_.size() << std::endl;
   for (auto it : words_) {
@@ -79,6 +79,7 @@ class Dictionary {
   std::string getWord(int32_t) const;
   const std::vector<int32_t>& getSubwords(int32_t) const;
   const std::vector<int32_t> getSubwords(const std::string&) const;
+  void getSubwords(const std::string&, std::vector<int32_t>&) const;
   void getSubwords(
       const std::string&,
       std::vector<int32_t>&,
@@ -91,19 +92,30 @@ class Dictionary {
   void add(const std::string&);
   bool readWord(std::istream&, std::string&) const;
   void readFromFile(std::istream&);
+  void update(std::istream&);
   std::string getLabel(int32_t) const;
   void save(std::ostream&) const;
   void load(std::istream&);
   std::vector<int64_t> getCounts(entry_type) const;
   int32_t getLine(std::istream&, std::vector<int32_t>&, std::vector<int32_t>&)
       const;
+  // Same, with the buffers of the word hashes and tokens given by the caller.
+  int32_t getLine(
+      std::istream&,
+      std::vector<int32_t>& words,
+      std::vector<int32_t>& labels,
+      std::vector<int32_t>& hashes,
+      std::string& token) const;
   int32_t getLine(std::istream&, std::vector<int32_t>&, std::minstd_rand&)
       const;
   void threshold(int64_t, int64_t);
   void prune(std::vector<int32_t>&);
+  void compactBuckets(std::istream&);
   bool isPruned() {
     return pruneidx_size_ >= 0;
   }
+  int64_t nbuckets() const;
+  int32_t getSubwordId(const std::string&) const;
   void dump(std::ostream&) const;
   void init();
 };
@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "eventlog.h"
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace fasttext {
+
+namespace {
+
+void writeString(std::ostream& out, const std::string& value) {
+  out << '"';
+  for (unsigned char c : value) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (c == '\n') {
+      out << "\\n";
+    } else if (c < 0x20) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c)
+          << std::dec << std::setfill(' ');
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+void writeNumber(std::ostream& out, double value) {
+  if (std::isfinite(value)) {
+    out << value;
+  } else {
+    out << "null";
+  }
+}
+
+} // namespace
+
+Event::Event(const std::string& type) {
+  out_ << std::setprecision(std::numeric_limits<double>::digits10);
+  out_ << "{\"event\": ";
+  writeString(out_, type);
+  double time = std::chrono::duration_cast<std::chrono::duration<double>>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+  add("time", time);
+}
+
+void Event::key(const std::string& key) {
+  out_ << ", ";
+  writeString(out_, key);
+  out_ << ": ";
+}
+
+Event& Event::add(const std::string& key, bool value) {
+  this->key(key);
+  out_ << (value ? "true" : "false");
+  return *this;
+}
+
+Event& Event::add(const std::string& key, int64_t value) {
+  this->key(key);
+  out_ << value;
+  return *this;
+}
+
+Event& Event::add(const std::string& key, int32_t value) {
+  return add(key, int64_t(value));
+}
+
+Event& Event::add(const std::string& key, double value) {
+  this->key(key);
+  writeNumber(out_, value);
+  return *this;
+}
+
+Event& Event::add(const std::string& key, const std::string& value) {
+  this->key(key);
+  writeString(out_, value);
+  return *this;
+}
+
+Event& Event::add(const std::string& key, const std::vector<double>& values) {
+  this->key(key);
+  out_ << '[';
+  for (size_t i = 0; i < values.size(); i++) {
+    if (i > 0) {
+      out_ << ", ";
+    }
+    writeNumber(out_, values[i]);
+  }
+  out_ << ']';
+  return *this;
+}
+
+std::string Event::str() const {
+  return out_.str() + "}\n";
+}
+
+EventLog::EventLog(const std::string& path) : fd_(-1) {
+  if (path.compare(0, 3, "fd:") == 0) {
+#ifdef _WIN32
+    throw std::invalid_argument("Events can't be written to a descriptor!");
+#else
+    fd_ = std::stoi(path.substr(3));
+    if (fd_ < 0) {
+      throw std::invalid_argument("Invalid file descriptor " + path + "!");
+    }
+#endif
+    return;
+  }
+  file_.open(path);
+  if (!file_.is_open()) {
+    throw std::invalid_argument(path + " cannot be opened for events!");
+  }
+}
+
+void EventLog::write(const Event& event) {
+  std::string line = event.str();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fd_ < 0) {
+    file_ << line << std::flush;
+    return;
+  }
+#ifndef _WIN32
+  const char* p = line.data();
+  int64_t size = line.size();
+  while (size > 0) {
+    ssize_t n = ::write(fd_, p, size);
+    if (n <= 0) {
+      return; // events are not worth failing for
+    }
+    p += n;
+    size -= n;
+  }
+#endif
+}
+
+} // namespace fasttext
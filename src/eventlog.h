@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fasttext {
+
+// A JSON object with an "event" type and the wall clock "time" in seconds
+// since the epoch, to which fields are added in order.
+class Event {
+ protected:
+  std::ostringstream out_;
+
+  void key(const std::string&);
+
+ public:
+  explicit Event(const std::string& type);
+
+  Event& add(const std::string& key, bool value);
+  Event& add(const std::string& key, int64_t value);
+  Event& add(const std::string& key, int32_t value);
+  // NaN and infinities are written as null
+  Event& add(const std::string& key, double value);
+  Event& add(const std::string& key, const std::string& value);
+  Event& add(const std::string& key, const std::vector<double>& values);
+  std::string str() const;
+};
+
+// Writes events as JSON lines to a file, or to an open file descriptor
+// given as "fd:<n>". Events are written whole and flushed, so that the
+// lines of concurrent writers don't mix and readers see them at once.
+class EventLog {
+ protected:
+  std::ofstream file_;
+  int fd_;
+  std::mutex mutex_;
+
+ public:
+  explicit EventLog(const std::string& path);
+  EventLog(const EventLog&) = delete;
+  EventLog& operator=(const EventLog&) = delete;
+
+  void write(const Event& event);
+};
+
+} // namespace fasttext
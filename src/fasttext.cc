@@ -9,10 +9,14 @@
 #include "fasttext.h"
 #include "loss.h"
 #include "quantmatrix.h"
+#include "scalarquantmatrix.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <numeric>
 #include <sstream>
 #include <stdexcept>
@@ -22,12 +26,71 @@
 
 namespace fasttext {
 
-constexpr int32_t FASTTEXT_VERSION = 12; /* Version 1b */
+constexpr int32_t FASTTEXT_VERSION = 14; /* Version 1d */
 constexpr int32_t FASTTEXT_FILEFORMAT_MAGIC_INT32 = 793712314;
+constexpr int32_t FASTTEXT_VECTORS_MAGIC_INT32 = 793712315;
+constexpr int32_t FASTTEXT_VECTORS_VERSION = 1;
 
-bool comparePairs(
-    const std::pair<real, std::string>& l,
-    const std::pair<real, std::string>& r);
+matrix_type getMatrixType(const Matrix& matrix) {
+  if (dynamic_cast<const QuantMatrix*>(&matrix)) {
+    return matrix_type::pq;
+  }
+  if (dynamic_cast<const ScalarQuantMatrix*>(&matrix)) {
+    return matrix_type::scalar;
+  }
+  return matrix_type::dense;
+}
+
+// Matrices trained in reduced precision are exported as dense matrices.
+std::shared_ptr<DenseMatrix> toDenseMatrix(
+    const std::shared_ptr<Matrix>& matrix) {
+  std::shared_ptr<HalfMatrix> half =
+      std::dynamic_pointer_cast<HalfMatrix>(matrix);
+  if (half) {
+    return std::make_shared<DenseMatrix>(half->toDense());
+  }
+  return std::dynamic_pointer_cast<DenseMatrix>(matrix);
+}
+
+namespace {
+
+// Computes the checksum of what is written to it.
+class ChecksumBuffer : public std::streambuf {
+ public:
+  uint32_t checksum = 0;
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (c != traits_type::eof()) {
+      char ch = c;
+      checksum = utils::crc32c(checksum, &ch, 1);
+    }
+    return traits_type::not_eof(c);
+  }
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    checksum = utils::crc32c(checksum, s, n);
+    return n;
+  }
+};
+
+// The loss is negative until the first thread reports it, which events
+// write as null.
+double getEventLoss(real loss) {
+  return loss >= 0 ? loss : std::numeric_limits<double>::quiet_NaN();
+}
+
+} // namespace
+
+std::shared_ptr<DenseMatrix> copyDenseMatrix(
+    const std::shared_ptr<Matrix>& matrix) {
+  std::shared_ptr<HalfMatrix> half =
+      std::dynamic_pointer_cast<HalfMatrix>(matrix);
+  if (half) {
+    return std::make_shared<DenseMatrix>(half->toDense());
+  }
+  return std::make_shared<DenseMatrix>(
+      *std::dynamic_pointer_cast<DenseMatrix>(matrix));
+}
 
 std::shared_ptr<Loss> FastText::createLoss(std::shared_ptr<Matrix>& output) {
   loss_name lossName = args_->loss;
@@ -48,7 +111,14 @@ std::shared_ptr<Loss> FastText::createLoss(std::shared_ptr<Matrix>& output) {
 }
 
 FastText::FastText()
-    : quant_(false), wordVectors_(nullptr), trainException_(nullptr) {}
+    : quant_(false),
+      wordVectors_(nullptr),
+      trainException_(nullptr),
+      checkpointPaused_(0),
+      checkpointFinished_(0),
+      checkpointGeneration_(0),
+      syncs_(0),
+      maxSyncs_(0) {}
 
 void FastText::addInputVector(Vector& vec, int32_t ind) const {
   vec.addRow(*input_, ind);
@@ -67,7 +137,7 @@ std::shared_ptr<const DenseMatrix> FastText::getInputMatrix() const {
     throw std::runtime_error("Can't export quantized matrix");
   }
   assert(input_.get());
-  return std::dynamic_pointer_cast<DenseMatrix>(input_);
+  return toDenseMatrix(input_);
 }
 
 void FastText::setMatrices(
@@ -88,7 +158,7 @@ std::shared_ptr<const DenseMatrix> FastText::getOutputMatrix() const {
     throw std::runtime_error("Can't export quantized matrix");
   }
   assert(output_.get());
-  return std::dynamic_pointer_cast<DenseMatrix>(output_);
+  return toDenseMatrix(output_);
 }
 
 int32_t FastText::getWordId(const std::string& word) const {
@@ -96,8 +166,7 @@ int32_t FastText::getWordId(const std::string& word) const {
 }
 
 int32_t FastText::getSubwordId(const std::string& subword) const {
-  int32_t h = dict_->hash(subword) % args_->bucket;
-  return dict_->nwords() + h;
+  return dict_->getSubwordId(subword);
 }
 
 int32_t FastText::getLabelId(const std::string& label) const {
@@ -111,9 +180,50 @@ int32_t FastText::getLabelId(const std::string& label) const {
 void FastText::getWordVector(Vector& vec, const std::string& word) const {
   const std::vector<int32_t>& ngrams = dict_->getSubwords(word);
   vec.zero();
-  for (int i = 0; i < ngrams.size(); i++) {
-    addInputVector(vec, ngrams[i]);
+  input_->addRowsToVector(vec, ngrams);
+  if (ngrams.size() > 0) {
+    vec.mul(1.0 / ngrams.size());
+  }
+}
+
+// Hashes what turns a line into a hidden vector: the words, the settings of
+// subwords and word n-grams, and the input matrix. Labels are left out.
+uint64_t FastText::getInputHash() const {
+  if (!input_) {
+    throw std::runtime_error("Model was loaded without its input matrix");
+  }
+  ChecksumBuffer words;
+  std::ostream wout(&words);
+  int32_t nwords = dict_->nwords();
+  for (int32_t value :
+       {args_->dim,
+        args_->minn,
+        args_->maxn,
+        args_->wordNgrams,
+        args_->bucket,
+        nwords}) {
+    wout.write((char*)&value, sizeof(int32_t));
+  }
+  wout << args_->label << '\0';
+  for (int32_t i = 0; i < nwords; i++) {
+    wout << dict_->getWord(i) << '\0';
   }
+  ChecksumBuffer input;
+  std::ostream iout(&input);
+  matrix_type type = getMatrixType(*input_);
+  iout.write((char*)&type, sizeof(matrix_type));
+  input_->save(iout);
+  return (uint64_t(words.checksum) << 32) | input.checksum;
+}
+
+void FastText::getWordVector(
+    Vector& vec,
+    const std::string& word,
+    Context& context) const {
+  std::vector<int32_t>& ngrams = context.words;
+  dict_->getSubwords(word, ngrams);
+  vec.zero();
+  input_->addRowsToVector(vec, ngrams);
   if (ngrams.size() > 0) {
     vec.mul(1.0 / ngrams.size());
   }
@@ -121,9 +231,68 @@ void FastText::getWordVector(Vector& vec, const std::string& word) const {
 
 void FastText::getSubwordVector(Vector& vec, const std::string& subword) const {
   vec.zero();
-  int32_t h = dict_->hash(subword) % args_->bucket;
-  h = h + dict_->nwords();
-  addInputVector(vec, h);
+  int32_t id = dict_->getSubwordId(subword);
+  if (id >= 0) {
+    addInputVector(vec, id);
+  }
+}
+
+// Formats the rows in parallel, in batches of kVectorsBatch rows per
+// thread, and writes each batch with a single call.
+constexpr int32_t kVectorsBatch = 1024;
+
+void FastText::writeVectors(
+    std::ostream& out,
+    int32_t n,
+    const std::function<std::string(int32_t)>& getName,
+    const std::function<void(int32_t, Vector&)>& getVector) const {
+  out << n << " " << args_->dim << std::endl;
+  int32_t nthreads = std::max(1, args_->thread);
+  std::vector<std::string> buffers(nthreads);
+  auto format = [&](int32_t begin, int32_t end, std::string& buffer) {
+    Vector vec(args_->dim);
+    char number[32];
+    buffer.clear();
+    for (int32_t i = begin; i < end; i++) {
+      getVector(i, vec);
+      buffer += getName(i);
+      buffer += ' ';
+      for (int64_t j = 0; j < vec.size(); j++) {
+        buffer.append(number, utils::formatReal(vec[j], number));
+        buffer += ' ';
+      }
+      buffer += '\n';
+    }
+  };
+  for (int32_t first = 0; first < n; first += nthreads * kVectorsBatch) {
+    if (nthreads > 1) {
+      std::vector<std::thread> threads;
+      for (int32_t t = 0; t < nthreads; t++) {
+        int32_t begin = std::min(n, first + t * kVectorsBatch);
+        int32_t end = std::min(n, begin + kVectorsBatch);
+        threads.push_back(std::thread(
+            [=, &format, &buffers]() { format(begin, end, buffers[t]); }));
+      }
+      for (int32_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+      }
+    } else {
+      // webassembly can't instantiate `std::thread`
+      format(first, std::min(n, first + kVectorsBatch), buffers[0]);
+    }
+    for (const auto& buffer : buffers) {
+      out.write(buffer.data(), buffer.size());
+    }
+  }
+}
+
+void FastText::computeWordVector(Vector& vec, int32_t i) const {
+  const std::vector<int32_t>& ngrams = dict_->getSubwords(i);
+  vec.zero();
+  input_->addRowsToVector(vec, ngrams);
+  if (ngrams.size() > 0) {
+    vec.mul(1.0 / ngrams.size());
+  }
 }
 
 void FastText::saveVectors(const std::string& filename) {
@@ -135,12 +304,46 @@ void FastText::saveVectors(const std::string& filename) {
     throw std::invalid_argument(
         filename + " cannot be opened for saving vectors!");
   }
-  ofs << dict_->nwords() << " " << args_->dim << std::endl;
-  Vector vec(args_->dim);
-  for (int32_t i = 0; i < dict_->nwords(); i++) {
+  writeVectors(
+      ofs,
+      dict_->nwords(),
+      [&](int32_t i) { return dict_->getWord(i); },
+      [&](int32_t i, Vector& vec) { computeWordVector(vec, i); });
+  ofs.close();
+}
+
+// Binary vectors start with a magic number, a version, the number of words
+// and the dimension, followed by the null-terminated words and the rows.
+void FastText::saveBinaryVectors(const std::string& filename) {
+  if (!input_ || !output_) {
+    throw std::runtime_error("Model never trained");
+  }
+  std::ofstream ofs(filename, std::ofstream::binary);
+  if (!ofs.is_open()) {
+    throw std::invalid_argument(
+        filename + " cannot be opened for saving vectors!");
+  }
+  const int32_t magic = FASTTEXT_VECTORS_MAGIC_INT32;
+  const int32_t version = FASTTEXT_VECTORS_VERSION;
+  int64_t n = dict_->nwords();
+  int64_t dim = args_->dim;
+  ofs.write((char*)&magic, sizeof(int32_t));
+  ofs.write((char*)&version, sizeof(int32_t));
+  ofs.write((char*)&n, sizeof(int64_t));
+  ofs.write((char*)&dim, sizeof(int64_t));
+  for (int32_t i = 0; i < n; i++) {
     std::string word = dict_->getWord(i);
-    getWordVector(vec, word);
-    ofs << word << " " << vec << std::endl;
+    ofs.write(word.data(), word.size() + 1);
+  }
+  DenseMatrix rows(kVectorsBatch, dim);
+  Vector vec(dim);
+  for (int32_t first = 0; first < n; first += kVectorsBatch) {
+    int32_t count = std::min(int64_t(kVectorsBatch), n - first);
+    for (int32_t i = 0; i < count; i++) {
+      computeWordVector(vec, first + i);
+      std::copy(vec.data(), vec.data() + dim, rows.data() + i * dim);
+    }
+    ofs.write((char*)rows.data(), count * dim * sizeof(real));
   }
   ofs.close();
 }
@@ -157,15 +360,17 @@ void FastText::saveOutput(const std::string& filename) {
   }
   int32_t n =
       (args_->model == model_name::sup) ? dict_->nlabels() : dict_->nwords();
-  ofs << n << " " << args_->dim << std::endl;
-  Vector vec(args_->dim);
-  for (int32_t i = 0; i < n; i++) {
-    std::string word = (args_->model == model_name::sup) ? dict_->getLabel(i)
-                                                         : dict_->getWord(i);
-    vec.zero();
-    vec.addRow(*output_, i);
-    ofs << word << " " << vec << std::endl;
-  }
+  writeVectors(
+      ofs,
+      n,
+      [&](int32_t i) {
+        return (args_->model == model_name::sup) ? dict_->getLabel(i)
+                                                 : dict_->getWord(i);
+      },
+      [&](int32_t i, Vector& vec) {
+        vec.zero();
+        vec.addRow(*output_, i);
+      });
   ofs.close();
 }
 
@@ -189,28 +394,108 @@ void FastText::signModel(std::ostream& out) {
   out.write((char*)&(version), sizeof(int32_t));
 }
 
-void FastText::saveModel(const std::string& filename) {
-  std::ofstream ofs(filename, std::ofstream::binary);
+void FastText::saveSections(
+    std::ofstream& out,
+    const SaveOptions& options,
+    const Matrix& input,
+    const Matrix& output,
+    const std::string& checkpoint) {
+  std::vector<Section> sections = {Section(section_id::args),
+                                   Section(section_id::dictionary),
+                                   Section(section_id::input),
+                                   Section(section_id::output)};
+  if (!checkpoint.empty()) {
+    sections.push_back(Section(section_id::checkpoint));
+  }
+  signModel(out);
+  int32_t nsections = sections.size();
+  out.write((char*)&nsections, sizeof(int32_t));
+  int64_t tocOffset = out.tellp();
+  for (const auto& section : sections) {
+    section.save(out);
+  }
+
+  for (auto& section : sections) {
+    const Matrix* matrix = nullptr;
+    if (section.id == section_id::input) {
+      matrix = &input;
+    } else if (section.id == section_id::output) {
+      matrix = &output;
+    }
+    if (options.compress) {
+      section.flags |= kCompressedSection;
+      if (matrix && getMatrixType(*matrix) == matrix_type::dense) {
+        section.flags |= kShuffledSection;
+      }
+    }
+    section.offset = out.tellp();
+    SectionWriter writer(out, section.flags, options.thread);
+    std::ostream sout(&writer);
+    if (section.id == section_id::args) {
+      args_->save(sout);
+    } else if (section.id == section_id::dictionary) {
+      dict_->save(sout);
+    } else if (section.id == section_id::checkpoint) {
+      sout.write(checkpoint.data(), checkpoint.size());
+    } else {
+      matrix_type type = getMatrixType(*matrix);
+      sout.write((char*)&(type), sizeof(matrix_type));
+      matrix->save(sout);
+    }
+    writer.finish(section);
+  }
+
+  out.seekp(tocOffset);
+  for (const auto& section : sections) {
+    section.save(out);
+  }
+}
+
+// The file is written to a temporary file which replaces `filename` once
+// complete, so that a failure never leaves a truncated model behind.
+void FastText::saveFile(
+    const std::string& filename,
+    const std::function<void(std::ofstream&)>& save) const {
+  std::string tmpname = filename + ".tmp";
+  std::ofstream ofs(tmpname, std::ofstream::binary);
   if (!ofs.is_open()) {
     throw std::invalid_argument(filename + " cannot be opened for saving!");
   }
+  try {
+    save(ofs);
+    ofs.close();
+    if (ofs.fail()) {
+      throw std::runtime_error("Error while writing " + filename);
+    }
+  } catch (...) {
+    ofs.close();
+    std::remove(tmpname.c_str());
+    throw;
+  }
+  if (std::rename(tmpname.c_str(), filename.c_str()) != 0) {
+    // rename does not replace existing files on all platforms
+    std::remove(filename.c_str());
+    if (std::rename(tmpname.c_str(), filename.c_str()) != 0) {
+      std::remove(tmpname.c_str());
+      throw std::runtime_error(filename + " cannot be replaced!");
+    }
+  }
+}
+
+void FastText::saveModel(
+    const std::string& filename,
+    const SaveOptions& options) {
   if (!input_ || !output_) {
     throw std::runtime_error("Model never trained");
   }
-  signModel(ofs);
-  args_->save(ofs);
-  dict_->save(ofs);
-
-  ofs.write((char*)&(quant_), sizeof(bool));
-  input_->save(ofs);
-
-  ofs.write((char*)&(args_->qout), sizeof(bool));
-  output_->save(ofs);
-
-  ofs.close();
+  saveFile(filename, [&](std::ofstream& ofs) {
+    saveSections(ofs, options, *input_, *output_, "");
+  });
 }
 
-void FastText::loadModel(const std::string& filename) {
+void FastText::loadModel(
+    const std::string& filename,
+    const LoadOptions& options) {
   std::ifstream ifs(filename, std::ifstream::binary);
   if (!ifs.is_open()) {
     throw std::invalid_argument(filename + " cannot be opened for loading!");
@@ -218,7 +503,7 @@ void FastText::loadModel(const std::string& filename) {
   if (!checkModel(ifs)) {
     throw std::invalid_argument(filename + " has wrong file format!");
   }
-  loadModel(ifs);
+  loadModel(ifs, options);
   ifs.close();
 }
 
@@ -236,44 +521,152 @@ void FastText::buildModel() {
   model_ = std::make_shared<Model>(input_, output_, loss, normalizeGradient);
 }
 
-void FastText::loadModel(std::istream& in) {
+std::shared_ptr<Matrix> FastText::loadMatrix(
+    std::istream& in,
+    matrix_type type) const {
+  if (type == matrix_type::pq) {
+    std::shared_ptr<QuantMatrix> matrix = std::make_shared<QuantMatrix>();
+    // rotations were introduced in version 13
+    matrix->load(in, version >= 13);
+    return matrix;
+  }
+  std::shared_ptr<Matrix> matrix;
+  if (type == matrix_type::scalar) {
+    matrix = std::make_shared<ScalarQuantMatrix>();
+  } else if (type == matrix_type::dense) {
+    matrix = std::make_shared<DenseMatrix>();
+  } else {
+    throw std::invalid_argument("Unknown matrix type in model file!");
+  }
+  matrix->load(in);
+  return matrix;
+}
+
+void FastText::loadArgs(std::istream& in) {
   args_ = std::make_shared<Args>();
-  input_ = std::make_shared<DenseMatrix>();
-  output_ = std::make_shared<DenseMatrix>();
   args_->load(in);
   if (version == 11 && args_->model == model_name::sup) {
     // backward compatibility: old supervised models do not use char ngrams.
     args_->maxn = 0;
   }
-  dict_ = std::make_shared<Dictionary>(args_, in);
+}
 
-  bool quant_input;
-  in.read((char*)&quant_input, sizeof(bool));
-  if (quant_input) {
-    quant_ = true;
-    input_ = std::make_shared<QuantMatrix>();
-  }
-  input_->load(in);
+void FastText::loadInput(std::istream& in) {
+  // versions before 13 stored a bool, which matches dense and pq types
+  matrix_type inputType;
+  in.read((char*)&inputType, sizeof(matrix_type));
+  quant_ = inputType != matrix_type::dense;
+  input_ = loadMatrix(in, inputType);
 
-  if (!quant_input && dict_->isPruned()) {
+  // dense models with remapped buckets are only valid since version 13
+  if (!quant_ && dict_->isPruned() && version < 13) {
     throw std::invalid_argument(
         "Invalid model file.\n"
         "Please download the updated model from www.fasttext.cc.\n"
         "See issue #332 on Github for more information.\n");
   }
+}
 
-  in.read((char*)&args_->qout, sizeof(bool));
-  if (quant_ && args_->qout) {
-    output_ = std::make_shared<QuantMatrix>();
+void FastText::loadOutput(std::istream& in) {
+  matrix_type outputType;
+  in.read((char*)&outputType, sizeof(matrix_type));
+  args_->qout = outputType != matrix_type::dense;
+  output_ = loadMatrix(in, outputType);
+}
+
+void FastText::loadSection(
+    std::istream& in,
+    const Section& section,
+    const LoadOptions& options,
+    const std::function<void(std::istream&)>& load) {
+  if (in.tellg() != section.offset) {
+    in.seekg(section.offset);
   }
-  output_->load(in);
+  SectionReader reader(in, section, options.verify, options.thread);
+  std::istream sin(&reader);
+  load(sin);
+  reader.finish();
+}
 
-  buildModel();
+void FastText::loadModel(std::istream& in) {
+  loadModel(in, LoadOptions());
+}
+
+void FastText::loadModel(std::istream& in, const LoadOptions& options) {
+  input_.reset();
+  output_.reset();
+  model_.reset();
+  wordVectors_.reset();
+  checkpoint_ = Checkpoint();
+  if (version < 14) {
+    loadArgs(in);
+    dict_ = std::make_shared<Dictionary>(args_, in);
+    loadInput(in);
+    if (options.output) {
+      loadOutput(in);
+      buildModel();
+    }
+    return;
+  }
+
+  int32_t nsections;
+  in.read((char*)&nsections, sizeof(int32_t));
+  std::vector<Section> sections(nsections, Section(section_id::args));
+  for (auto& section : sections) {
+    section.load(in);
+  }
+  // sections are looked up by id, unknown sections are ignored
+  auto find = [&sections](section_id id) -> const Section& {
+    for (const auto& section : sections) {
+      if (section.id == id) {
+        return section;
+      }
+    }
+    throw std::invalid_argument(
+        "Model file is missing section " + std::to_string(int32_t(id)) +
+        ".");
+  };
+  loadSection(in, find(section_id::args), options, [&](std::istream& sin) {
+    loadArgs(sin);
+  });
+  loadSection(
+      in, find(section_id::dictionary), options, [&](std::istream& sin) {
+        dict_ = std::make_shared<Dictionary>(args_, sin);
+      });
+  const Section& input = find(section_id::input);
+  if (options.input) {
+    loadSection(in, input, options, [&](std::istream& sin) {
+      loadInput(sin);
+    });
+  } else {
+    // isQuant only needs the type of the input matrix
+    matrix_type inputType;
+    in.seekg(input.offset);
+    SectionReader reader(in, input, false, 1);
+    std::istream sin(&reader);
+    sin.read((char*)&inputType, sizeof(matrix_type));
+    quant_ = inputType != matrix_type::dense;
+  }
+  if (options.output) {
+    loadSection(in, find(section_id::output), options, [&](std::istream& sin) {
+      loadOutput(sin);
+    });
+  }
+  for (const auto& section : sections) {
+    if (section.id == section_id::checkpoint) {
+      loadSection(in, section, options, [&](std::istream& sin) {
+        checkpoint_.load(sin);
+      });
+    }
+  }
+  if (input_ && output_) {
+    buildModel();
+  }
 }
 
 std::tuple<int64_t, double, double> FastText::progressInfo(real progress) {
   double t = utils::getDuration(start_, std::chrono::steady_clock::now());
-  double lr = args_->lr * (1.0 - progress);
+  double lr = getLearningRate(progress);
   double wst = 0;
 
   int64_t eta = 2592000; // Default to one month in seconds (720 * 3600)
@@ -302,12 +695,12 @@ void FastText::printInfo(real progress, real loss, std::ostream& log_stream) {
   log_stream << std::flush;
 }
 
-std::vector<int32_t> FastText::selectEmbeddings(int32_t cutoff) const {
-  std::shared_ptr<DenseMatrix> input =
-      std::dynamic_pointer_cast<DenseMatrix>(input_);
-  Vector norms(input->size(0));
-  input->l2NormRow(norms);
-  std::vector<int32_t> idx(input->size(0), 0);
+std::vector<int32_t> FastText::selectEmbeddings(
+    const DenseMatrix& input,
+    int32_t cutoff) const {
+  Vector norms(input.size(0));
+  input.l2NormRow(norms);
+  std::vector<int32_t> idx(input.size(0), 0);
   std::iota(idx.begin(), idx.end(), 0);
   auto eosid = dict_->getId(Dictionary::EOS);
   std::sort(idx.begin(), idx.end(), [&norms, eosid](size_t i1, size_t i2) {
@@ -321,21 +714,26 @@ std::vector<int32_t> FastText::selectEmbeddings(int32_t cutoff) const {
 }
 
 void FastText::quantize(const Args& qargs, const TrainCallback& callback) {
-  if (args_->model != model_name::sup) {
+  if (args_->model != model_name::sup &&
+      (qargs.qtype == quant_name::pq || qargs.cutoff > 0)) {
     throw std::invalid_argument(
-        "For now we only support quantization of supervised models");
+        "For now we only support product quantization and pruning of "
+        "supervised models");
+  }
+  if (qargs.qtype != quant_name::pq &&
+      (qargs.qnorm || qargs.qrotate || qargs.qretrain)) {
+    throw std::invalid_argument(
+        "-qnorm, -qrotate and -qretrain only apply to -qtype pq");
   }
   args_->input = qargs.input;
   args_->qout = qargs.qout;
   args_->output = qargs.output;
-  std::shared_ptr<DenseMatrix> input =
-      std::dynamic_pointer_cast<DenseMatrix>(input_);
-  std::shared_ptr<DenseMatrix> output =
-      std::dynamic_pointer_cast<DenseMatrix>(output_);
+  std::shared_ptr<DenseMatrix> input = toDenseMatrix(input_);
+  std::shared_ptr<DenseMatrix> output = toDenseMatrix(output_);
   bool normalizeGradient = (args_->model == model_name::sup);
 
   if (qargs.cutoff > 0 && qargs.cutoff < input->size(0)) {
-    auto idx = selectEmbeddings(qargs.cutoff);
+    auto idx = selectEmbeddings(*input, qargs.cutoff);
     dict_->prune(idx);
     std::shared_ptr<DenseMatrix> ninput =
         std::make_shared<DenseMatrix>(idx.size(), args_->dim);
@@ -350,18 +748,73 @@ void FastText::quantize(const Args& qargs, const TrainCallback& callback) {
       args_->lr = qargs.lr;
       args_->thread = qargs.thread;
       args_->verbose = qargs.verbose;
-      auto loss = createLoss(output_);
+      // output is a dense copy when output_ is stored in half precision
+      std::shared_ptr<Matrix> woutput = output;
+      auto loss = createLoss(woutput);
       model_ = std::make_shared<Model>(input, output, loss, normalizeGradient);
       startThreads(callback);
+      output_ = output;
     }
   }
-  input_ = std::make_shared<QuantMatrix>(
-      std::move(*(input.get())), qargs.dsub, qargs.qnorm);
+  if (qargs.qtype == quant_name::pq && qargs.qretrain) {
+    // quantization-aware finetuning: the forward pass uses the codes while
+    // the gradients update both the codebooks and a dense copy of the
+    // embeddings, from which codes are reassigned after every epoch but the
+    // last one: the output matrix is trained with the codes as they are.
+    std::shared_ptr<QuantMatrix> qinput = std::make_shared<QuantMatrix>(
+        DenseMatrix(*input), qargs.dsub, qargs.qnorm, qargs.qrotate);
+    qinput->enableTraining(std::move(*(input.get())));
+    input_ = qinput;
+    args_->epoch = qargs.epoch;
+    args_->lr = qargs.lr;
+    args_->thread = qargs.thread;
+    args_->verbose = qargs.verbose;
+    std::shared_ptr<Matrix> woutput = output;
+    auto loss = createLoss(woutput);
+    model_ = std::make_shared<Model>(input_, output, loss, normalizeGradient);
+    // The first thread reaching a new epoch reassigns the codes, while the
+    // others keep training on them, as they do with the shared parameters.
+    std::atomic<int32_t> requantized(0);
+    std::mutex requantizeMutex;
+    TrainCallback requantizing =
+        [&](float progress, float loss, double wst, double lr, int64_t eta) {
+          int32_t epoch =
+              std::min(int32_t(progress * qargs.epoch), qargs.epoch - 1);
+          if (epoch > requantized) {
+            std::lock_guard<std::mutex> lock(requantizeMutex);
+            if (epoch > requantized) {
+              qinput->requantize();
+              requantized = epoch;
+            }
+          }
+          if (callback) {
+            callback(progress, loss, wst, lr, eta);
+          }
+        };
+    startThreads(requantizing);
+    qinput->disableTraining();
+    output_ = output;
+  }
+  if (qargs.qtype == quant_name::pq) {
+    if (!qargs.qretrain) {
+      input_ = std::make_shared<QuantMatrix>(
+          std::move(*(input.get())), qargs.dsub, qargs.qnorm, qargs.qrotate);
+    }
+
+    if (args_->qout) {
+      output_ = std::make_shared<QuantMatrix>(
+          std::move(*(output.get())), 2, qargs.qnorm, qargs.qrotate);
+    }
+  } else {
+    scalar_type type = (qargs.qtype == quant_name::int8) ? scalar_type::int8
+                                                         : scalar_type::fp16;
+    input_ = std::make_shared<ScalarQuantMatrix>(*input, type);
 
-  if (args_->qout) {
-    output_ = std::make_shared<QuantMatrix>(
-        std::move(*(output.get())), 2, qargs.qnorm);
+    if (args_->qout) {
+      output_ = std::make_shared<ScalarQuantMatrix>(*output, type);
+    }
   }
+  wordVectors_.reset();
   quant_ = true;
   auto loss = createLoss(output_);
   model_ = std::make_shared<Model>(input_, output_, loss, normalizeGradient);
@@ -433,18 +886,16 @@ void FastText::test(std::istream& in, int32_t k, real threshold, Meter& meter)
   std::vector<int32_t> line;
   std::vector<int32_t> labels;
   Predictions predictions;
-  Model::State state(args_->dim, dict_->nlabels(), 0);
+  Context context;
   in.clear();
   in.seekg(0, std::ios_base::beg);
 
   while (in.peek() != EOF) {
-    line.clear();
-    labels.clear();
-    dict_->getLine(in, line, labels);
+    dict_->getLine(in, line, labels, context.hashes, context.token);
 
     if (!labels.empty() && !line.empty()) {
       predictions.clear();
-      predict(k, line, predictions, threshold);
+      predict(k, line, predictions, threshold, context);
       meter.log(labels, predictions);
     }
   }
@@ -455,14 +906,39 @@ void FastText::predict(
     const std::vector<int32_t>& words,
     Predictions& predictions,
     real threshold) const {
+  Context context;
+  predict(k, words, predictions, threshold, context);
+}
+
+// Sizes the buffers of a context for the loaded model.
+void FastText::prepareContext(Context& context) const {
+  if (!context.state || context.state->hidden.size() != args_->dim ||
+      context.state->output.size() != dict_->nlabels()) {
+    context.state = std::unique_ptr<Model::State>(
+        new Model::State(args_->dim, dict_->nlabels(), 0));
+  }
+  if (!context.vector || context.vector->size() != args_->dim) {
+    context.vector = std::unique_ptr<Vector>(new Vector(args_->dim));
+  }
+}
+
+void FastText::predict(
+    int32_t k,
+    const std::vector<int32_t>& words,
+    Predictions& predictions,
+    real threshold,
+    Context& context) const {
   if (words.empty()) {
     return;
   }
-  Model::State state(args_->dim, dict_->nlabels(), 0);
   if (args_->model != model_name::sup) {
     throw std::invalid_argument("Model needs to be supervised for prediction!");
   }
-  model_->predict(words, k, threshold, predictions, state);
+  if (!model_) {
+    throw std::runtime_error("Model was loaded without its matrices");
+  }
+  prepareContext(context);
+  model_->predict(words, k, threshold, predictions, *context.state);
 }
 
 bool FastText::predictLine(
@@ -470,15 +946,26 @@ bool FastText::predictLine(
     std::vector<std::pair<real, std::string>>& predictions,
     int32_t k,
     real threshold) const {
+  Context context;
+  return predictLine(in, predictions, k, threshold, context);
+}
+
+bool FastText::predictLine(
+    std::istream& in,
+    std::vector<std::pair<real, std::string>>& predictions,
+    int32_t k,
+    real threshold,
+    Context& context) const {
   predictions.clear();
   if (in.peek() == EOF) {
     return false;
   }
 
-  std::vector<int32_t> words, labels;
-  dict_->getLine(in, words, labels);
-  Predictions linePredictions;
-  predict(k, words, linePredictions, threshold);
+  dict_->getLine(
+      in, context.words, context.labels, context.hashes, context.token);
+  Predictions& linePredictions = context.predictions;
+  linePredictions.clear();
+  predict(k, context.words, linePredictions, threshold, context);
   for (const auto& p : linePredictions) {
     predictions.push_back(
         std::make_pair(std::exp(p.first), dict_->getLabel(p.second)));
@@ -487,26 +974,84 @@ bool FastText::predictLine(
   return true;
 }
 
-void FastText::getSentenceVector(std::istream& in, fasttext::Vector& svec) {
+void FastText::predictLines(
+    const std::vector<std::string>& lines,
+    const std::vector<int32_t>& k,
+    const std::vector<real>& threshold,
+    std::vector<std::vector<std::pair<real, std::string>>>& predictions,
+    std::vector<Context>& contexts) const {
+  if (args_->model != model_name::sup) {
+    throw std::invalid_argument("Model needs to be supervised for prediction!");
+  }
+  if (!model_) {
+    throw std::runtime_error("Model was loaded without its matrices");
+  }
+  assert(contexts.size() >= lines.size());
+  predictions.resize(lines.size());
+  std::vector<const std::vector<int32_t>*> inputs;
+  std::vector<int32_t> batchK;
+  std::vector<real> batchThreshold;
+  std::vector<Predictions*> heaps;
+  std::vector<Model::State*> states;
+  for (size_t i = 0; i < lines.size(); i++) {
+    Context& context = contexts[i];
+    prepareContext(context);
+    std::istringstream in(lines[i]);
+    dict_->getLine(
+        in, context.words, context.labels, context.hashes, context.token);
+    context.predictions.clear();
+    if (context.words.empty()) {
+      continue;
+    }
+    inputs.push_back(&context.words);
+    batchK.push_back(k[i]);
+    batchThreshold.push_back(threshold[i]);
+    heaps.push_back(&context.predictions);
+    states.push_back(context.state.get());
+  }
+  model_->predictBatch(inputs, batchK, batchThreshold, heaps, states);
+  for (size_t i = 0; i < lines.size(); i++) {
+    predictions[i].clear();
+    for (const auto& p : contexts[i].predictions) {
+      predictions[i].push_back(
+          std::make_pair(std::exp(p.first), dict_->getLabel(p.second)));
+    }
+  }
+}
+
+void FastText::getSentenceVector(std::istream& in, fasttext::Vector& svec)
+    const {
+  Context context;
+  getSentenceVector(in, svec, context);
+}
+
+void FastText::getSentenceVector(
+    std::istream& in,
+    fasttext::Vector& svec,
+    Context& context) const {
   svec.zero();
   if (args_->model == model_name::sup) {
-    std::vector<int32_t> line, labels;
-    dict_->getLine(in, line, labels);
-    for (int32_t i = 0; i < line.size(); i++) {
-      addInputVector(svec, line[i]);
-    }
+    std::vector<int32_t>& line = context.words;
+    dict_->getLine(in, line, context.labels, context.hashes, context.token);
+    input_->addRowsToVector(svec, line);
     if (!line.empty()) {
       svec.mul(1.0 / line.size());
     }
   } else {
-    Vector vec(args_->dim);
-    std::string sentence;
-    std::getline(in, sentence);
-    std::istringstream iss(sentence);
-    std::string word;
+    prepareContext(context);
+    Vector& vec = *context.vector;
+    const std::string& sentence = context.line;
+    std::string& word = context.token;
+    std::getline(in, context.line);
+    const char* whitespace = " \t\n\v\f\r";
     int32_t count = 0;
-    while (iss >> word) {
-      getWordVector(vec, word);
+    size_t end = 0;
+    while ((end = sentence.find_first_not_of(whitespace, end)) !=
+           std::string::npos) {
+      size_t begin = end;
+      end = std::min(sentence.find_first_of(whitespace, begin), sentence.size());
+      word.assign(sentence, begin, end - begin);
+      getWordVector(vec, word, context);
       real norm = vec.norm();
       if (norm > 0) {
         vec.mul(1.0 / norm);
@@ -537,7 +1082,7 @@ std::vector<std::pair<std::string, Vector>> FastText::getNgramVectors(
   return result;
 }
 
-void FastText::precomputeWordVectors(DenseMatrix& wordVectors) {
+void FastText::precomputeWordVectors(DenseMatrix& wordVectors) const {
   Vector vec(args_->dim);
   wordVectors.zero();
   for (int32_t i = 0; i < dict_->nwords(); i++) {
@@ -550,32 +1095,53 @@ void FastText::precomputeWordVectors(DenseMatrix& wordVectors) {
   }
 }
 
-void FastText::lazyComputeWordVectors() {
+// The first caller computes the word vectors while the others wait.
+std::shared_ptr<const DenseMatrix> FastText::lazyComputeWordVectors() const {
+  std::lock_guard<std::mutex> lock(wordVectorsMutex_);
   if (!wordVectors_) {
-    wordVectors_ = std::unique_ptr<DenseMatrix>(
-        new DenseMatrix(dict_->nwords(), args_->dim));
-    precomputeWordVectors(*wordVectors_);
+    auto wordVectors =
+        std::make_shared<DenseMatrix>(dict_->nwords(), args_->dim);
+    precomputeWordVectors(*wordVectors);
+    wordVectors_ = wordVectors;
   }
+  return wordVectors_;
 }
 
 std::vector<std::pair<real, std::string>> FastText::getNN(
     const std::string& word,
-    int32_t k) {
-  Vector query(args_->dim);
+    int32_t k) const {
+  Context context;
+  return getNN(word, k, context);
+}
 
-  getWordVector(query, word);
+std::vector<std::pair<real, std::string>>
+FastText::getNN(const std::string& word, int32_t k, Context& context) const {
+  prepareContext(context);
+  Vector& query = *context.vector;
 
-  lazyComputeWordVectors();
-  assert(wordVectors_);
-  return getNN(*wordVectors_, query, k, {word});
+  getWordVector(query, word, context);
+
+  auto wordVectors = lazyComputeWordVectors();
+  return getNN(*wordVectors, query, k, {word}, context.predictions);
 }
 
+// The heap holds word ids, so that only the k neighbors are copied as
+// strings.
 std::vector<std::pair<real, std::string>> FastText::getNN(
     const DenseMatrix& wordVectors,
     const Vector& query,
     int32_t k,
-    const std::set<std::string>& banSet) {
-  std::vector<std::pair<real, std::string>> heap;
+    const std::set<std::string>& banSet,
+    Predictions& heap) const {
+  auto compare = [](const std::pair<real, int32_t>& l,
+                    const std::pair<real, int32_t>& r) {
+    return l.first > r.first;
+  };
+  std::vector<int32_t> banned;
+  for (const auto& word : banSet) {
+    banned.push_back(dict_->getId(word));
+  }
+  heap.clear();
 
   real queryNorm = query.norm();
   if (std::abs(queryNorm) < 1e-8) {
@@ -583,32 +1149,37 @@ std::vector<std::pair<real, std::string>> FastText::getNN(
   }
 
   for (int32_t i = 0; i < dict_->nwords(); i++) {
-    std::string word = dict_->getWord(i);
-    if (banSet.find(word) == banSet.end()) {
+    if (std::find(banned.begin(), banned.end(), i) == banned.end()) {
       real dp = wordVectors.dotRow(query, i);
       real similarity = dp / queryNorm;
 
       if (heap.size() == k && similarity < heap.front().first) {
         continue;
       }
-      heap.push_back(std::make_pair(similarity, word));
-      std::push_heap(heap.begin(), heap.end(), comparePairs);
+      heap.push_back(std::make_pair(similarity, i));
+      std::push_heap(heap.begin(), heap.end(), compare);
       if (heap.size() > k) {
-        std::pop_heap(heap.begin(), heap.end(), comparePairs);
+        std::pop_heap(heap.begin(), heap.end(), compare);
         heap.pop_back();
       }
     }
   }
-  std::sort_heap(heap.begin(), heap.end(), comparePairs);
+  std::sort_heap(heap.begin(), heap.end(), compare);
 
-  return heap;
+  std::vector<std::pair<real, std::string>> neighbors;
+  neighbors.reserve(heap.size());
+  for (const auto& neighbor : heap) {
+    neighbors.push_back(
+        std::make_pair(neighbor.first, dict_->getWord(neighbor.second)));
+  }
+  return neighbors;
 }
 
 std::vector<std::pair<real, std::string>> FastText::getAnalogies(
     int32_t k,
     const std::string& wordA,
     const std::string& wordB,
-    const std::string& wordC) {
+    const std::string& wordC) const {
   Vector query = Vector(args_->dim);
   query.zero();
 
@@ -620,28 +1191,205 @@ std::vector<std::pair<real, std::string>> FastText::getAnalogies(
   getWordVector(buffer, wordC);
   query.addVector(buffer, 1.0 / (buffer.norm() + 1e-8));
 
-  lazyComputeWordVectors();
-  assert(wordVectors_);
-  return getNN(*wordVectors_, query, k, {wordA, wordB, wordC});
+  auto wordVectors = lazyComputeWordVectors();
+  Predictions heap;
+  return getNN(*wordVectors, query, k, {wordA, wordB, wordC}, heap);
 }
 
 bool FastText::keepTraining(const int64_t ntokens) const {
-  return tokenCount_ < args_->epoch * ntokens && !trainException_;
+  if (stream_) {
+    return getProgress(ntokens) < 1.0 && !stream_->done() && !trainException_;
+  }
+  return tokenCount_ < args_->epoch * ntokens / args_->nodes &&
+      !trainException_;
+}
+
+// The size of a stream is unknown, so lr decays over -streamDuration
+// seconds or -streamTokens tokens, by default epoch times the tokens of the
+// dictionary.
+real FastText::getProgress(const int64_t ntokens) const {
+  if (!stream_) {
+    return real(tokenCount_) / (args_->epoch * ntokens / args_->nodes);
+  }
+  real progress;
+  if (args_->streamDuration > 0) {
+    progress = utils::getDuration(start_, std::chrono::steady_clock::now()) /
+        args_->streamDuration;
+  } else if (args_->streamTokens > 0) {
+    progress = real(tokenCount_) / args_->streamTokens;
+  } else {
+    progress = real(tokenCount_) / (args_->epoch * ntokens);
+  }
+  return std::min(progress, real(1.0));
+}
+
+// The processes of a distributed run train like the threads of a single
+// process, except that averaging their parameters divides the updates of
+// each of them by the number of processes. They make up for it with a
+// learning rate nodes times larger, without which a run would progress
+// like a single process trained for epoch / nodes epochs.
+real FastText::getLearningRate(real progress) const {
+  return args_->lr * args_->nodes * (1.0 - progress);
+}
+
+int32_t FastText::trainLine(
+    std::istream& in,
+    Model::State& state,
+    real lr,
+    std::vector<int32_t>& line,
+    std::vector<int32_t>& labels) {
+  Model::Stats* stats = state.stats;
+  std::chrono::steady_clock::time_point start;
+  if (stats) {
+    start = std::chrono::steady_clock::now();
+  }
+  int32_t ntokens = 0;
+  if (args_->model == model_name::sup) {
+    ntokens = dict_->getLine(in, line, labels);
+  } else {
+    ntokens = dict_->getLine(in, line, state.rng);
+  }
+  if (stats) {
+    stats->tokenizeTime +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+    stats->lines++;
+    stats->tokens += ntokens;
+    if (args_->model == model_name::sup) {
+      stats->skippedLines += labels.empty() || line.empty();
+    } else {
+      // words dropped by the subsampling of frequent words
+      stats->discardedTokens += ntokens - line.size();
+      stats->skippedLines += line.size() < 2;
+    }
+  }
+  if (args_->model == model_name::sup) {
+    supervised(state, lr, line, labels);
+  } else if (args_->model == model_name::cbow) {
+    cbow(state, lr, line);
+  } else if (args_->model == model_name::sg) {
+    skipgram(state, lr, line);
+  }
+  return ntokens;
+}
+
+// Threads merge their counters by batches of lines to avoid contention.
+constexpr int64_t kStatsLines = 4096;
+
+void FastText::mergeStats(Model::Stats& stats) {
+  std::lock_guard<std::mutex> lock(statsMutex_);
+  stats_.add(stats);
+  stats = Model::Stats();
+}
+
+// Writes the counters of training as a JSON line. Times are summed over
+// threads.
+void FastText::writeStats(std::ostream& out, real progress) {
+  Model::Stats stats;
+  {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats = stats_;
+  }
+  double seconds =
+      utils::getDuration(start_, std::chrono::steady_clock::now());
+  out << "{\"seconds\": " << seconds << ", \"progress\": " << progress
+      << ", \"threads\": " << args_->thread << ", \"lines\": " << stats.lines
+      << ", \"skippedLines\": " << stats.skippedLines
+      << ", \"tokens\": " << stats.tokens
+      << ", \"discardedTokens\": " << stats.discardedTokens
+      << ", \"updates\": " << stats.updates
+      << ", \"tokensPerSecond\": "
+      << (seconds > 0 ? stats.tokens / seconds : 0.0)
+      << ", \"tokenizeSeconds\": " << stats.tokenizeTime * 1e-9
+      << ", \"hiddenSeconds\": " << stats.hiddenTime * 1e-9
+      << ", \"lossSeconds\": " << stats.lossTime * 1e-9
+      << ", \"gradientSeconds\": " << stats.gradientTime * 1e-9 << "}"
+      << std::endl;
+}
+
+// Reports the progress since the last event, given the tokens of each
+// thread at that time and the seconds elapsed since.
+void FastText::writeProgressEvent(
+    real progress,
+    std::vector<int64_t>& lastTokens,
+    double interval) {
+  double wst;
+  double lr;
+  int64_t eta;
+  std::tie<double, double, int64_t>(wst, lr, eta) = progressInfo(progress);
+  std::vector<double> threadWords(threadTokens_.size());
+  for (size_t i = 0; i < threadTokens_.size(); i++) {
+    int64_t tokens = threadTokens_[i];
+    threadWords[i] = interval > 0 ? (tokens - lastTokens[i]) / interval : 0.0;
+    lastTokens[i] = tokens;
+  }
+  events_->write(
+      Event("trainProgress")
+          .add("seconds",
+               utils::getDuration(start_, std::chrono::steady_clock::now()))
+          .add("progress", double(progress))
+          .add("tokens", int64_t(tokenCount_))
+          .add("loss", getEventLoss(loss_))
+          .add("lr", lr)
+          .add("wordsPerSecondPerThread", wst)
+          .add("threadWordsPerSecond", threadWords)
+          .add("eta", eta)
+          .add("residentBytes", utils::getResidentMemory()));
+}
+
+void FastText::setEventLog(std::shared_ptr<EventLog> events) {
+  events_ = events;
+}
+
+std::shared_ptr<EventLog> FastText::getEventLog() const {
+  return events_;
 }
 
 void FastText::trainThread(int32_t threadId, const TrainCallback& callback) {
   std::ifstream ifs(args_->input);
-  utils::seek(ifs, threadId * utils::size(ifs) / args_->thread);
-
-  Model::State state(args_->dim, output_->size(0), threadId + args_->seed);
+  // threads of all the processes start at different offsets
+  const int64_t shard = args_->rank * args_->thread + threadId;
+  Model::State state(args_->dim, output_->size(0), shard + args_->seed);
+  HalfMatrix::seedRounding(shard + args_->seed);
+  int64_t localTokenCount = 0;
+  const std::string& resumed = checkpoint_.threads[threadId];
+  if (resumed.empty()) {
+    utils::seek(
+        ifs, shard * utils::size(ifs) / (args_->nodes * args_->thread));
+  } else {
+    std::istringstream in(resumed);
+    int64_t offset;
+    in.read((char*)&offset, sizeof(int64_t));
+    in.read((char*)&localTokenCount, sizeof(int64_t));
+    state.load(in);
+    utils::seek(ifs, offset);
+  }
+  Model::Stats stats;
+  if (!args_->trainStats.empty()) {
+    state.stats = &stats;
+  }
 
   const int64_t ntokens = dict_->ntokens();
-  int64_t localTokenCount = 0;
   std::vector<int32_t> line, labels;
   uint64_t callbackCounter = 0;
+  auto lastCheckpoint = std::chrono::steady_clock::now();
   try {
     while (keepTraining(ntokens)) {
-      real progress = real(tokenCount_) / (args_->epoch * ntokens);
+      if (args_->checkpoint > 0 && threadId == 0 &&
+          utils::getDuration(
+              lastCheckpoint, std::chrono::steady_clock::now()) >=
+              args_->checkpoint) {
+        saveCheckpoint(ifs, state, localTokenCount);
+        lastCheckpoint = std::chrono::steady_clock::now();
+      } else if (checkpointRequested_) {
+        pauseForCheckpoint(threadId, ifs, state, localTokenCount);
+      }
+      if (cluster_ && threadId == 0 && syncs_ < maxSyncs_ &&
+          tokenCount_ >= (syncs_ + 1) * args_->syncTokens) {
+        syncParameters();
+      }
+      real progress = getProgress(ntokens);
       if (callback && ((callbackCounter++ % 64) == 0)) {
         double wst;
         double lr;
@@ -650,81 +1398,564 @@ void FastText::trainThread(int32_t threadId, const TrainCallback& callback) {
             progressInfo(progress);
         callback(progress, loss_, wst, lr, eta);
       }
-      real lr = args_->lr * (1.0 - progress);
-      if (args_->model == model_name::sup) {
-        localTokenCount += dict_->getLine(ifs, line, labels);
-        supervised(state, lr, line, labels);
-      } else if (args_->model == model_name::cbow) {
-        localTokenCount += dict_->getLine(ifs, line, state.rng);
-        cbow(state, lr, line);
-      } else if (args_->model == model_name::sg) {
-        localTokenCount += dict_->getLine(ifs, line, state.rng);
-        skipgram(state, lr, line);
-      }
+      real lr = getLearningRate(progress);
+      localTokenCount += trainLine(ifs, state, lr, line, labels);
       if (localTokenCount > args_->lrUpdateRate) {
         tokenCount_ += localTokenCount;
+        if (events_) {
+          threadTokens_[threadId] += localTokenCount;
+        }
         localTokenCount = 0;
-        if (threadId == 0 && args_->verbose > 1) {
+        if (threadId == 0 && (args_->verbose > 1 || events_)) {
           loss_ = state.getLoss();
         }
       }
+      if (stats.lines >= kStatsLines) {
+        mergeStats(stats);
+      }
     }
   } catch (DenseMatrix::EncounteredNaNError&) {
     trainException_ = std::current_exception();
+  } catch (Cluster::Error&) {
+    trainException_ = std::current_exception();
   }
+  mergeStats(stats);
   if (threadId == 0)
     loss_ = state.getLoss();
   ifs.close();
+  if (threadId != 0) {
+    // a pending checkpoint does not wait for finished threads
+    std::lock_guard<std::mutex> lock(checkpointMutex_);
+    checkpointFinished_++;
+    checkpointCondition_.notify_all();
+  }
+}
+
+// Trains on the blocks of lines of stream_ until it ends or lr reaches 0.
+// A block read by a thread is not trained on by the others.
+void FastText::streamThread(int32_t threadId, const TrainCallback& callback) {
+  Model::State state(args_->dim, output_->size(0), threadId + args_->seed);
+  HalfMatrix::seedRounding(threadId + args_->seed);
+  Model::Stats stats;
+  if (!args_->trainStats.empty()) {
+    state.stats = &stats;
+  }
+  const int64_t ntokens = dict_->ntokens();
+  int64_t localTokenCount = 0;
+  std::vector<int32_t> line, labels;
+  uint64_t callbackCounter = 0;
+  std::string block;
+  std::istringstream in;
+  try {
+    while (keepTraining(ntokens)) {
+      // gives up waiting to check the progress, which -streamDuration makes
+      // grow while the input is idle
+      if (!stream_->pop(block, std::chrono::milliseconds(100))) {
+        continue;
+      }
+      in.clear();
+      in.str(block);
+      // getLine rewinds streams at their end
+      while (in.peek() != std::char_traits<char>::eof()) {
+        real progress = getProgress(ntokens);
+        if (progress >= 1.0 || trainException_) {
+          break;
+        }
+        if (callback && ((callbackCounter++ % 64) == 0)) {
+          double wst;
+          double lr;
+          int64_t eta;
+          std::tie<double, double, int64_t>(wst, lr, eta) =
+              progressInfo(progress);
+          callback(progress, loss_, wst, lr, eta);
+        }
+        real lr = getLearningRate(progress);
+        localTokenCount += trainLine(in, state, lr, line, labels);
+        if (localTokenCount > args_->lrUpdateRate) {
+          tokenCount_ += localTokenCount;
+          if (events_) {
+            threadTokens_[threadId] += localTokenCount;
+          }
+          localTokenCount = 0;
+          if (threadId == 0 && (args_->verbose > 1 || events_)) {
+            loss_ = state.getLoss();
+          }
+        }
+        if (stats.lines >= kStatsLines) {
+          mergeStats(stats);
+        }
+      }
+    }
+  } catch (DenseMatrix::EncounteredNaNError&) {
+    trainException_ = std::current_exception();
+  }
+  mergeStats(stats);
+  tokenCount_ += localTokenCount;
+  if (threadId == 0) {
+    loss_ = state.getLoss();
+  }
+}
+
+// Connects to the other processes and checks that they train the same
+// model. Every process makes maxSyncs_ averagings during training and a
+// last one at the end, whatever its speed.
+void FastText::startCluster() {
+  if (args_->input == "-" || args_->checkpoint > 0 || args_->resume) {
+    throw std::invalid_argument(
+        "Distributed training needs an input file and no checkpoints!");
+  }
+  if (!std::dynamic_pointer_cast<DenseMatrix>(input_) ||
+      !std::dynamic_pointer_cast<DenseMatrix>(output_)) {
+    throw std::invalid_argument(
+        "Distributed training needs fp32 precision!");
+  }
+  cluster_ =
+      std::make_shared<Cluster>(args_->coordinator, args_->rank, args_->nodes);
+  cluster_->check(dict_->nwords(), "number of words");
+  cluster_->check(dict_->nlabels(), "number of labels");
+  cluster_->check(dict_->ntokens(), "number of tokens");
+  cluster_->check(input_->size(0), "input matrix size");
+  cluster_->check(output_->size(0), "output matrix size");
+  cluster_->check(args_->dim, "dimension");
+  cluster_->check(args_->thread, "number of threads");
+  cluster_->check(args_->epoch, "number of epochs");
+  cluster_->check(args_->syncTokens, "averaging interval");
+  cluster_->check(args_->sparseSync, "synchronization mode");
+  syncs_ = 0;
+  maxSyncs_ = args_->epoch * dict_->ntokens() / args_->nodes /
+      std::max<int64_t>(args_->syncTokens, 1);
+  if (args_->sparseSync) {
+    auto input = std::dynamic_pointer_cast<DenseMatrix>(input_);
+    auto output = std::dynamic_pointer_cast<DenseMatrix>(output_);
+    syncedInput_.reset(new DenseMatrix(*input));
+    syncedOutput_.reset(new DenseMatrix(*output));
+    input->trackUpdatedRows(true);
+    output->trackUpdatedRows(true);
+  }
+  if (args_->verbose > 0) {
+    std::cerr << "Connected " << args_->nodes << " processes" << std::endl;
+  }
+}
+
+// Averages the parameters over the processes, which getLearningRate makes
+// up for. The other threads keep training meanwhile, like they update the
+// parameters without locks.
+void FastText::syncParameters() {
+  auto input = std::dynamic_pointer_cast<DenseMatrix>(input_);
+  auto output = std::dynamic_pointer_cast<DenseMatrix>(output_);
+  if (args_->sparseSync) {
+    syncRows(*input, *syncedInput_);
+    syncRows(*output, *syncedOutput_);
+  } else {
+    cluster_->average(input->data(), input->rows() * input->cols());
+    cluster_->average(output->data(), output->rows() * output->cols());
+  }
+  syncs_++;
+}
+
+// Since the processes hold the same `synced` parameters after an
+// averaging, averaging the parameters amounts to averaging their changes,
+// and only the updated rows changed. Like the full averaging, it divides
+// the updates of each process by the number of processes, which
+// getLearningRate makes up for. Updates made during the exchange are kept,
+// to be sent with the next averaging.
+void FastText::syncRows(DenseMatrix& mat, DenseMatrix& synced) {
+  const int64_t dim = mat.cols();
+  std::vector<int32_t> rows = mat.takeUpdatedRows();
+  std::vector<real> deltas(rows.size() * dim);
+  for (size_t i = 0; i < rows.size(); i++) {
+    for (int64_t j = 0; j < dim; j++) {
+      deltas[i * dim + j] = mat.at(rows[i], j) - synced.at(rows[i], j);
+    }
+  }
+  std::vector<int32_t> allRows;
+  std::vector<real> averages;
+  cluster_->averageRows(rows, deltas, dim, allRows, averages);
+  size_t k = 0;
+  for (size_t i = 0; i < allRows.size(); i++) {
+    const real* sent = nullptr;
+    for (; k < rows.size() && rows[k] <= allRows[i]; k++) {
+      if (rows[k] == allRows[i]) {
+        sent = deltas.data() + k * dim;
+      }
+    }
+    for (int64_t j = 0; j < dim; j++) {
+      real average = averages[i * dim + j];
+      mat.at(allRows[i], j) += average - (sent ? sent[j] : 0.0);
+      synced.at(allRows[i], j) += average;
+    }
+  }
+  if (args_->verbose > 2) {
+    std::cerr << "Averaged " << allRows.size() << " of " << mat.rows()
+              << " rows" << std::endl;
+  }
+}
+
+void FastText::stopCluster() {
+  cluster_ = nullptr;
+  syncedInput_ = nullptr;
+  syncedOutput_ = nullptr;
+  if (auto input = std::dynamic_pointer_cast<DenseMatrix>(input_)) {
+    input->trackUpdatedRows(false);
+  }
+  if (auto output = std::dynamic_pointer_cast<DenseMatrix>(output_)) {
+    output->trackUpdatedRows(false);
+  }
+}
+
+std::string FastText::getThreadState(
+    std::ifstream& ifs,
+    const Model::State& state,
+    int64_t localTokenCount) const {
+  std::ostringstream out;
+  int64_t offset = ifs.tellg();
+  out.write((char*)&offset, sizeof(int64_t));
+  out.write((char*)&localTokenCount, sizeof(int64_t));
+  state.save(out);
+  return out.str();
+}
+
+void FastText::pauseForCheckpoint(
+    int32_t threadId,
+    std::ifstream& ifs,
+    const Model::State& state,
+    int64_t localTokenCount) {
+  std::unique_lock<std::mutex> lock(checkpointMutex_);
+  if (!checkpointRequested_) {
+    return;
+  }
+  checkpoint_.threads[threadId] = getThreadState(ifs, state, localTokenCount);
+  checkpointPaused_++;
+  int64_t generation = checkpointGeneration_;
+  checkpointCondition_.notify_all();
+  checkpointCondition_.wait(
+      lock, [&]() { return checkpointGeneration_ != generation; });
+}
+
+// Called by the first thread. The other threads are paused while the
+// matrices are copied, then the copy is written in the background.
+void FastText::saveCheckpoint(
+    std::ifstream& ifs,
+    const Model::State& state,
+    int64_t localTokenCount) {
+  if (checkpointWriter_.joinable()) {
+    checkpointWriter_.join();
+  }
+  std::shared_ptr<DenseMatrix> input;
+  std::shared_ptr<DenseMatrix> output;
+  std::string checkpoint;
+  {
+    std::unique_lock<std::mutex> lock(checkpointMutex_);
+    checkpointRequested_ = true;
+    checkpointCondition_.wait(lock, [&]() {
+      return checkpointPaused_ + checkpointFinished_ == args_->thread - 1;
+    });
+    checkpoint_.threads[0] = getThreadState(ifs, state, localTokenCount);
+    checkpoint_.tokenCount = tokenCount_;
+    std::ostringstream out;
+    checkpoint_.save(out);
+    checkpoint = out.str();
+    input = copyDenseMatrix(input_);
+    output = copyDenseMatrix(output_);
+    checkpointPaused_ = 0;
+    checkpointRequested_ = false;
+    checkpointGeneration_++;
+  }
+  checkpointCondition_.notify_all();
+
+  std::string filename = args_->output + ".ckpt";
+  auto write = [this, filename, input, output, checkpoint]() {
+    try {
+      saveFile(filename, [&](std::ofstream& ofs) {
+        saveSections(ofs, SaveOptions(), *input, *output, checkpoint);
+      });
+    } catch (const std::exception& e) {
+      std::cerr << "Warning: checkpoint failed: " << e.what() << std::endl;
+    }
+  };
+  if (args_->thread > 1) {
+    checkpointWriter_ = std::thread(write);
+  } else {
+    // webassembly can't instantiate `std::thread`
+    write();
+  }
+}
+
+void FastText::Checkpoint::save(std::ostream& out) const {
+  int32_t nthreads = threads.size();
+  out.write((char*)&tokenCount, sizeof(int64_t));
+  out.write((char*)&nthreads, sizeof(int32_t));
+  for (const auto& thread : threads) {
+    int64_t size = thread.size();
+    out.write((char*)&size, sizeof(int64_t));
+    out.write(thread.data(), size);
+  }
+}
+
+void FastText::Checkpoint::load(std::istream& in) {
+  int32_t nthreads;
+  in.read((char*)&tokenCount, sizeof(int64_t));
+  in.read((char*)&nthreads, sizeof(int32_t));
+  threads.assign(nthreads, std::string());
+  for (auto& thread : threads) {
+    int64_t size;
+    in.read((char*)&size, sizeof(int64_t));
+    thread.resize(size);
+    in.read(&thread[0], size);
+  }
+}
+
+// Resumes from <output>.ckpt, which must have been written by a run with
+// the same model arguments. The learning rate and the number of epochs
+// may change.
+void FastText::loadCheckpoint() {
+  std::string filename = args_->output + ".ckpt";
+  Args args = *args_;
+  loadModel(filename);
+  if (checkpoint_.threads.size() != args.thread) {
+    throw std::invalid_argument(
+        filename + " was written by " +
+        std::to_string(checkpoint_.threads.size()) + " threads, not " +
+        std::to_string(args.thread) + "!");
+  }
+  if (quant_ || args_->model != args.model || args_->loss != args.loss ||
+      args_->dim != args.dim || args_->bucket != args.bucket ||
+      args_->minn != args.minn || args_->maxn != args.maxn ||
+      args_->wordNgrams != args.wordNgrams) {
+    throw std::invalid_argument(
+        filename + " does not match the training arguments!");
+  }
+  // the dictionary shares args_
+  *args_ = args;
+  if (args_->precision != precision_name::fp32) {
+    input_ = std::make_shared<HalfMatrix>(
+        *std::dynamic_pointer_cast<DenseMatrix>(input_), getHalfType());
+    output_ = std::make_shared<HalfMatrix>(
+        *std::dynamic_pointer_cast<DenseMatrix>(output_), getHalfType());
+  }
+}
+
+void checkPretrainedDimension(int64_t dim, int64_t expected) {
+  if (dim != expected) {
+    throw std::invalid_argument(
+        "Dimension of pretrained vectors (" + std::to_string(dim) +
+        ") does not match dimension (" + std::to_string(expected) + ")!");
+  }
 }
 
 std::shared_ptr<Matrix> FastText::getInputMatrixFromFile(
     const std::string& filename) const {
-  std::ifstream in(filename);
-  std::vector<std::string> words;
-  std::shared_ptr<DenseMatrix> mat; // temp. matrix for pretrained vectors
-  int64_t n, dim;
+  std::ifstream in(filename, std::ifstream::binary);
   if (!in.is_open()) {
     throw std::invalid_argument(filename + " cannot be opened for loading!");
   }
-  in >> n >> dim;
-  if (dim != args_->dim) {
-    throw std::invalid_argument(
-        "Dimension of pretrained vectors (" + std::to_string(dim) +
-        ") does not match dimension (" + std::to_string(args_->dim) + ")!");
+  int32_t magic = 0;
+  in.read((char*)&magic, sizeof(int32_t));
+  in.clear();
+  in.seekg(std::streampos(0));
+
+  std::shared_ptr<DenseMatrix> input;
+  if (magic == FASTTEXT_FILEFORMAT_MAGIC_INT32) {
+    in.close();
+    input = getInputMatrixFromModel(filename);
+  } else if (magic == FASTTEXT_VECTORS_MAGIC_INT32) {
+    input = getInputMatrixFromBinaryVectors(in);
+  } else {
+    input = getInputMatrixFromText(in, filename);
   }
-  mat = std::make_shared<DenseMatrix>(n, dim);
-  for (size_t i = 0; i < n; i++) {
-    std::string word;
-    in >> word;
-    words.push_back(word);
-    dict_->add(word);
-    for (size_t j = 0; j < dim; j++) {
-      in >> mat->at(i, j);
-    }
+  if (args_->precision != precision_name::fp32) {
+    return std::make_shared<HalfMatrix>(*input, getHalfType());
   }
-  in.close();
+  return input;
+}
 
+// Adds the pretrained words to the dictionary and allocates the input
+// matrix. rows[i] is the row of words[i], or -1 when the vector should be
+// skipped; the last vector of a duplicated word is kept.
+std::shared_ptr<DenseMatrix> FastText::createPretrainedMatrix(
+    const std::vector<std::string>& words,
+    std::vector<int32_t>& rows) const {
+  for (const auto& word : words) {
+    dict_->add(word);
+  }
   dict_->threshold(1, 0);
   dict_->init();
   std::shared_ptr<DenseMatrix> input = std::make_shared<DenseMatrix>(
-      dict_->nwords() + args_->bucket, args_->dim);
+      dict_->nwords() + dict_->nbuckets(),
+      args_->dim,
+      DenseMatrix::Uninitialized());
   input->uniform(1.0 / args_->dim, args_->thread, args_->seed);
 
-  for (size_t i = 0; i < n; i++) {
+  rows.assign(words.size(), -1);
+  std::vector<bool> seen(dict_->nwords(), false);
+  for (int64_t i = int64_t(words.size()) - 1; i >= 0; i--) {
     int32_t idx = dict_->getId(words[i]);
-    if (idx < 0 || idx >= dict_->nwords()) {
+    if (idx < 0 || idx >= dict_->nwords() || seen[idx]) {
       continue;
     }
-    for (size_t j = 0; j < dim; j++) {
-      input->at(idx, j) = mat->at(i, j);
+    seen[idx] = true;
+    rows[i] = idx;
+  }
+  return input;
+}
+
+// Text vectors are parsed in two passes: a sequential pass collecting the
+// words and line offsets, then a parallel pass writing the vectors
+// directly into their rows.
+std::shared_ptr<DenseMatrix> FastText::getInputMatrixFromText(
+    std::ifstream& in,
+    const std::string& filename) const {
+  int64_t n, dim;
+  std::string line;
+  std::getline(in, line);
+  std::istringstream header(line);
+  if (!(header >> n >> dim)) {
+    throw std::invalid_argument(filename + " has an invalid header!");
+  }
+  checkPretrainedDimension(dim, args_->dim);
+
+  std::vector<std::string> words;
+  std::vector<int64_t> offsets;
+  int64_t offset = in.tellg();
+  while (words.size() < n && std::getline(in, line)) {
+    words.push_back(line.substr(0, line.find_first_of(" \t")));
+    offsets.push_back(offset);
+    offset += line.size() + 1;
+  }
+  in.close();
+  if (words.size() < n) {
+    throw std::invalid_argument(
+        filename + " contains less than " + std::to_string(n) + " vectors!");
+  }
+
+  std::vector<int32_t> rows;
+  std::shared_ptr<DenseMatrix> input = createPretrainedMatrix(words, rows);
+  auto parse = [&](int64_t begin, int64_t end, std::exception_ptr& error) {
+    try {
+      std::ifstream ifs(filename, std::ifstream::binary);
+      ifs.seekg(std::streampos(offsets[begin]));
+      std::string text;
+      for (int64_t i = begin; i < end; i++) {
+        std::getline(ifs, text);
+        if (rows[i] < 0) {
+          continue;
+        }
+        const char* p = text.data() + words[i].size();
+        const char* last = text.data() + text.size();
+        real* row = input->data() + int64_t(rows[i]) * dim;
+        for (int64_t j = 0; j < dim; j++) {
+          while (p < last && (*p == ' ' || *p == '\t' || *p == '\r')) {
+            p++;
+          }
+          p = utils::parseReal(p, last, row[j]);
+          if (!p) {
+            throw std::invalid_argument(
+                "Invalid pretrained vector for word " + words[i]);
+          }
+        }
+      }
+    } catch (...) {
+      error = std::current_exception();
+    }
+  };
+  int32_t nthreads = std::max(1, args_->thread);
+  std::vector<std::exception_ptr> errors(nthreads);
+  if (nthreads > 1) {
+    std::vector<std::thread> threads;
+    for (int32_t i = 0; i < nthreads; i++) {
+      threads.push_back(std::thread([=, &parse, &errors]() {
+        parse(n * i / nthreads, n * (i + 1) / nthreads, errors[i]);
+      }));
+    }
+    for (int32_t i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+  } else {
+    // webassembly can't instantiate `std::thread`
+    parse(0, n, errors[0]);
+  }
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
     }
   }
   return input;
 }
 
+std::shared_ptr<DenseMatrix> FastText::getInputMatrixFromBinaryVectors(
+    std::istream& in) const {
+  int32_t magic, version;
+  int64_t n, dim;
+  in.read((char*)&magic, sizeof(int32_t));
+  in.read((char*)&version, sizeof(int32_t));
+  if (version > FASTTEXT_VECTORS_VERSION) {
+    throw std::invalid_argument("Unsupported version of binary vectors.");
+  }
+  in.read((char*)&n, sizeof(int64_t));
+  in.read((char*)&dim, sizeof(int64_t));
+  checkPretrainedDimension(dim, args_->dim);
+
+  std::vector<std::string> words(n);
+  for (int64_t i = 0; i < n; i++) {
+    std::getline(in, words[i], '\0');
+  }
+  std::vector<int32_t> rows;
+  std::shared_ptr<DenseMatrix> input = createPretrainedMatrix(words, rows);
+  std::vector<real> skipped(dim);
+  for (int64_t i = 0; i < n; i++) {
+    real* row = (rows[i] >= 0) ? input->data() + int64_t(rows[i]) * dim
+                               : skipped.data();
+    in.read((char*)row, dim * sizeof(real));
+  }
+  if (!in) {
+    throw std::invalid_argument("Invalid binary vectors file.");
+  }
+  return input;
+}
+
+std::shared_ptr<DenseMatrix> FastText::getInputMatrixFromModel(
+    const std::string& filename) const {
+  FastText model;
+  model.loadModel(filename);
+  checkPretrainedDimension(model.getDimension(), args_->dim);
+
+  std::shared_ptr<const Dictionary> dict = model.getDictionary();
+  std::vector<std::string> words(dict->nwords());
+  for (int32_t i = 0; i < dict->nwords(); i++) {
+    words[i] = dict->getWord(i);
+  }
+  std::vector<int32_t> rows;
+  std::shared_ptr<DenseMatrix> input = createPretrainedMatrix(words, rows);
+  Vector vec(args_->dim);
+  for (int64_t i = 0; i < words.size(); i++) {
+    if (rows[i] >= 0) {
+      model.getWordVector(vec, words[i]);
+      std::copy(
+          vec.data(),
+          vec.data() + args_->dim,
+          input->data() + int64_t(rows[i]) * args_->dim);
+    }
+  }
+  return input;
+}
+
+half_type FastText::getHalfType() const {
+  return (args_->precision == precision_name::bf16) ? half_type::bf16
+                                                    : half_type::fp16;
+}
+
 std::shared_ptr<Matrix> FastText::createRandomMatrix() const {
+  if (args_->precision != precision_name::fp32) {
+    std::shared_ptr<HalfMatrix> input = std::make_shared<HalfMatrix>(
+        dict_->nwords() + dict_->nbuckets(), args_->dim, getHalfType());
+    input->uniform(1.0 / args_->dim, args_->thread, args_->seed);
+
+    return input;
+  }
   std::shared_ptr<DenseMatrix> input = std::make_shared<DenseMatrix>(
-      dict_->nwords() + args_->bucket, args_->dim);
+      dict_->nwords() + dict_->nbuckets(),
+      args_->dim,
+      DenseMatrix::Uninitialized());
   input->uniform(1.0 / args_->dim, args_->thread, args_->seed);
 
   return input;
@@ -733,6 +1964,13 @@ std::shared_ptr<Matrix> FastText::createRandomMatrix() const {
 std::shared_ptr<Matrix> FastText::createTrainOutputMatrix() const {
   int64_t m =
       (args_->model == model_name::sup) ? dict_->nlabels() : dict_->nwords();
+  if (args_->precision != precision_name::fp32) {
+    std::shared_ptr<HalfMatrix> output =
+        std::make_shared<HalfMatrix>(m, args_->dim, getHalfType());
+    output->zero();
+
+    return output;
+  }
   std::shared_ptr<DenseMatrix> output =
       std::make_shared<DenseMatrix>(m, args_->dim);
   output->zero();
@@ -741,25 +1979,58 @@ std::shared_ptr<Matrix> FastText::createTrainOutputMatrix() const {
 }
 
 void FastText::train(const Args& args, const TrainCallback& callback) {
-  args_ = std::make_shared<Args>(args);
-  dict_ = std::make_shared<Dictionary>(args_);
-  if (args_->input == "-") {
-    // manage expectations
-    throw std::invalid_argument("Cannot use stdin for training!");
+  if (args.input == "-") {
+    trainFromStdin(args, callback);
+    return;
   }
+  args_ = std::make_shared<Args>(args);
   std::ifstream ifs(args_->input);
   if (!ifs.is_open()) {
     throw std::invalid_argument(
         args_->input + " cannot be opened for training!");
   }
-  dict_->readFromFile(ifs);
+  if (args_->resume) {
+    loadCheckpoint();
+  } else {
+    checkpoint_ = Checkpoint();
+    dict_ = std::make_shared<Dictionary>(args_);
+    dict_->readFromFile(ifs);
+    if (args_->compactBuckets) {
+      dict_->compactBuckets(ifs);
+    }
+    if (!args_->pretrainedVectors.empty()) {
+      input_ = getInputMatrixFromFile(args_->pretrainedVectors);
+    } else {
+      input_ = createRandomMatrix();
+    }
+    output_ = createTrainOutputMatrix();
+  }
   ifs.close();
 
-  if (!args_->pretrainedVectors.empty()) {
-    input_ = getInputMatrixFromFile(args_->pretrainedVectors);
-  } else {
-    input_ = createRandomMatrix();
+  quant_ = false;
+  auto loss = createLoss(output_);
+  bool normalizeGradient = (args_->model == model_name::sup);
+  model_ = std::make_shared<Model>(input_, output_, loss, normalizeGradient);
+  startThreads(callback);
+}
+
+// The words of stdin can't be counted before training, so the dictionary
+// is the one of args.inputModel, and the parameters are trained from
+// scratch.
+void FastText::trainFromStdin(const Args& args, const TrainCallback& callback) {
+  if (args.inputModel.empty()) {
+    throw std::invalid_argument(
+        "Training from stdin needs the dictionary of -inputModel!");
   }
+  LoadOptions options;
+  options.input = false;
+  options.output = false;
+  loadModel(args.inputModel, options);
+  // the dictionary shares args_
+  *args_ = getDictionaryArgs(args);
+
+  checkpoint_ = Checkpoint();
+  input_ = createRandomMatrix();
   output_ = createTrainOutputMatrix();
   quant_ = false;
   auto loss = createLoss(output_);
@@ -768,6 +2039,129 @@ void FastText::train(const Args& args, const TrainCallback& callback) {
   startThreads(callback);
 }
 
+// Returns args with the arguments used by the dictionary of the loaded
+// model: the model and how words are split into subwords and ngrams.
+Args FastText::getDictionaryArgs(const Args& args) const {
+  Args merged = args;
+  merged.model = args_->model;
+  merged.bucket = args_->bucket;
+  merged.minn = args_->minn;
+  merged.maxn = args_->maxn;
+  merged.wordNgrams = args_->wordNgrams;
+  merged.label = args_->label;
+  return merged;
+}
+
+// Continues the training of args.inputModel on args.input. The arguments
+// which define the parameters (model, loss, dim, buckets, ngrams, label)
+// are those of the model. The hyperparameters are those of the model
+// unless they are given on the command line.
+void FastText::update(const Args& args, const TrainCallback& callback) {
+  std::ifstream ifs;
+  if (args.input != "-") {
+    ifs.open(args.input);
+    if (!ifs.is_open()) {
+      throw std::invalid_argument(
+          args.input + " cannot be opened for training!");
+    }
+  }
+  loadModel(args.inputModel);
+  if (quant_) {
+    throw std::invalid_argument("Quantized models cannot be updated!");
+  }
+  if (args_->loss == loss_name::hs) {
+    // the tree is built from the counts, which the new data changes
+    throw std::invalid_argument(
+        "Models trained with hierarchical softmax cannot be updated!");
+  }
+  Args merged = getDictionaryArgs(args);
+  merged.loss = args_->loss;
+  merged.dim = args_->dim;
+  if (!args.isManual("lr")) {
+    merged.lr = args_->lr;
+  }
+  if (!args.isManual("lrUpdateRate")) {
+    merged.lrUpdateRate = args_->lrUpdateRate;
+  }
+  if (!args.isManual("epoch")) {
+    merged.epoch = args_->epoch;
+  }
+  if (!args.isManual("ws")) {
+    merged.ws = args_->ws;
+  }
+  if (!args.isManual("neg")) {
+    merged.neg = args_->neg;
+  }
+  if (!args.isManual("minCount")) {
+    merged.minCount = args_->minCount;
+  }
+  if (!args.isManual("minCountLabel")) {
+    merged.minCountLabel = args_->minCountLabel;
+  }
+  if (!args.isManual("t")) {
+    merged.t = args_->t;
+  }
+  // the dictionary shares args_
+  *args_ = merged;
+
+  // a stream can't be read twice, so its words are not added
+  if (ifs.is_open()) {
+    int32_t nwords = dict_->nwords();
+    int32_t nlabels = dict_->nlabels();
+    dict_->update(ifs);
+    ifs.close();
+    growMatrices(nwords, nlabels);
+  }
+
+  checkpoint_ = Checkpoint();
+  quant_ = false;
+  auto loss = createLoss(output_);
+  bool normalizeGradient = (args_->model == model_name::sup);
+  model_ = std::make_shared<Model>(input_, output_, loss, normalizeGradient);
+  startThreads(callback);
+}
+
+// Adds the rows of the words and labels appended to the dictionary since it
+// had `nwords` words and `nlabels` labels. New word vectors are initialized
+// like in train, and new output rows are zero.
+void FastText::growMatrices(int32_t nwords, int32_t nlabels) {
+  auto input = std::dynamic_pointer_cast<DenseMatrix>(input_);
+  auto output = std::dynamic_pointer_cast<DenseMatrix>(output_);
+  const int64_t dim = input->cols();
+  const int64_t nbuckets = input->rows() - nwords;
+  const int64_t newWords = dict_->nwords() - nwords;
+
+  auto grownInput = std::make_shared<DenseMatrix>(
+      dict_->nwords() + nbuckets, dim, DenseMatrix::Uninitialized());
+  DenseMatrix words(newWords, dim, DenseMatrix::Uninitialized());
+  words.uniform(1.0 / dim, args_->thread, args_->seed);
+  std::copy(
+      input->data(), input->data() + nwords * dim, grownInput->data());
+  std::copy(
+      words.data(),
+      words.data() + newWords * dim,
+      grownInput->data() + nwords * dim);
+  std::copy(
+      input->data() + nwords * dim,
+      input->data() + input->rows() * dim,
+      grownInput->data() + dict_->nwords() * dim);
+
+  int64_t m = (args_->model == model_name::sup) ? nlabels : nwords;
+  auto grownOutput = std::make_shared<DenseMatrix>(
+      (args_->model == model_name::sup) ? dict_->nlabels() : dict_->nwords(),
+      dim);
+  grownOutput->zero();
+  std::copy(
+      output->data(), output->data() + m * dim, grownOutput->data());
+
+  input_ = grownInput;
+  output_ = grownOutput;
+  if (args_->precision != precision_name::fp32) {
+    input_ = std::make_shared<HalfMatrix>(*grownInput, getHalfType());
+    output_ = std::make_shared<HalfMatrix>(*grownOutput, getHalfType());
+  }
+}
+
 void FastText::abort() {
   try {
     throw AbortError();
@@ -777,32 +2171,162 @@ void FastText::abort() {
 }
 
 void FastText::startThreads(const TrainCallback& callback) {
+  std::ofstream statsOut;
+  if (!args_->trainStats.empty()) {
+    statsOut.open(args_->trainStats);
+    if (!statsOut.is_open()) {
+      throw std::invalid_argument(
+          args_->trainStats + " cannot be opened for training stats!");
+    }
+  }
+  if (!events_ && !args_->events.empty()) {
+    events_ = std::make_shared<EventLog>(args_->events);
+  }
+  if (args_->nodes > 1) {
+    try {
+      startCluster();
+    } catch (...) {
+      stopCluster();
+      throw;
+    }
+  }
+  std::thread reader;
+  if (args_->input == "-") {
+    if (args_->checkpoint > 0 || args_->resume) {
+      throw std::invalid_argument(
+          "Cannot checkpoint or resume training from stdin!");
+    }
+    // webassembly can't instantiate `std::thread`, so a single thread reads
+    // the blocks itself, unless it must stop after -streamDuration while the
+    // input is idle
+    bool readerThread = args_->thread > 1 || args_->streamDuration > 0;
+    // file descriptor 0 is the standard input
+    stream_ = std::make_shared<StreamQueue>(
+        0, readerThread ? 4 * args_->thread : 0);
+    if (readerThread) {
+      std::shared_ptr<StreamQueue> stream = stream_;
+      reader = std::thread([stream]() { stream->run(); });
+    }
+  }
   start_ = std::chrono::steady_clock::now();
-  tokenCount_ = 0;
+  checkpoint_.threads.resize(args_->thread);
+  tokenCount_ = checkpoint_.tokenCount;
+  checkpointRequested_ = false;
+  checkpointPaused_ = 0;
+  checkpointFinished_ = 0;
   loss_ = -1;
   trainException_ = nullptr;
+  stats_ = Model::Stats();
+  threadTokens_ = std::vector<std::atomic<int64_t>>(args_->thread);
+  std::vector<int64_t> lastTokens(args_->thread, 0);
+  if (events_) {
+    events_->write(Event("trainStart")
+                       .add("supervised", args_->model == model_name::sup)
+                       .add("lossFunction", args_->lossToString(args_->loss))
+                       .add("dim", args_->dim)
+                       .add("epoch", args_->epoch)
+                       .add("lr", args_->lr)
+                       .add("threads", args_->thread)
+                       .add("tokens", dict_->ntokens())
+                       .add("words", dict_->nwords())
+                       .add("labels", dict_->nlabels())
+                       .add("nodes", args_->nodes)
+                       .add("rank", args_->rank));
+  }
   std::vector<std::thread> threads;
   if (args_->thread > 1) {
     for (int32_t i = 0; i < args_->thread; i++) {
-      threads.push_back(std::thread([=]() { trainThread(i, callback); }));
+      threads.push_back(std::thread([=]() {
+        if (stream_) {
+          streamThread(i, callback);
+        } else {
+          trainThread(i, callback);
+        }
+      }));
     }
+  } else if (stream_) {
+    streamThread(0, callback);
   } else {
     // webassembly can't instantiate `std::thread`
     trainThread(0, callback);
   }
   const int64_t ntokens = dict_->ntokens();
+  auto lastStats = start_;
+  auto lastEvent = start_;
   // Same condition as trainThread
   while (keepTraining(ntokens)) {
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
     if (loss_ >= 0 && args_->verbose > 1) {
-      real progress = real(tokenCount_) / (args_->epoch * ntokens);
+      real progress = getProgress(ntokens);
       std::cerr << "\r";
       printInfo(progress, loss_, std::cerr);
     }
+    auto now = std::chrono::steady_clock::now();
+    if (statsOut.is_open() &&
+        utils::getDuration(lastStats, now) >= args_->statsInterval) {
+      writeStats(statsOut, getProgress(ntokens));
+      lastStats = now;
+    }
+    double sinceEvent = utils::getDuration(lastEvent, now);
+    if (events_ && sinceEvent >= args_->statsInterval) {
+      writeProgressEvent(getProgress(ntokens), lastTokens, sinceEvent);
+      lastEvent = now;
+    }
+  }
+  if (stream_) {
+    // wakes up the threads waiting for blocks
+    stream_->close();
   }
   for (int32_t i = 0; i < threads.size(); i++) {
     threads[i].join();
   }
+  if (statsOut.is_open()) {
+    writeStats(statsOut, std::min(getProgress(ntokens), real(1.0)));
+  }
+  if (checkpointWriter_.joinable()) {
+    checkpointWriter_.join();
+  }
+  checkpoint_ = Checkpoint();
+  if (stream_) {
+    // the reader returns once the stream is closed, but on Windows it stays
+    // blocked on the input if training stopped before its end
+#ifdef _WIN32
+    if (reader.joinable() && !stream_->ended()) {
+      reader.detach();
+    }
+#endif
+    if (reader.joinable()) {
+      reader.join();
+    }
+    stream_ = nullptr;
+  }
+  if (cluster_) {
+    try {
+      while (syncs_ < maxSyncs_ && !trainException_) {
+        syncParameters();
+      }
+      if (!trainException_) {
+        syncParameters();
+      }
+    } catch (Cluster::Error&) {
+      trainException_ = std::current_exception();
+    }
+    stopCluster();
+  }
+  if (events_) {
+    double seconds =
+        utils::getDuration(start_, std::chrono::steady_clock::now());
+    events_->write(
+        Event("trainEnd")
+            .add("seconds", seconds)
+            .add("tokens", int64_t(tokenCount_))
+            .add("loss", getEventLoss(loss_))
+            .add(
+                "wordsPerSecond",
+                seconds > 0 ? tokenCount_ / seconds : 0.0)
+            .add("residentBytes", utils::getResidentMemory())
+            .add("failed", bool(trainException_)));
+  }
   if (trainException_) {
     std::exception_ptr exception = trainException_;
     trainException_ = nullptr;
@@ -823,10 +2347,4 @@ bool FastText::isQuant() const {
   return quant_;
 }
 
-bool comparePairs(
-    const std::pair<real, std::string>& l,
-    const std::pair<real, std::string>& r) {
-  return l.first > r.first;
-}
-
 } // namespace fasttext
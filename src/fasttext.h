@@ -10,33 +10,113 @@
 
 #include <time.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <set>
+#include <string>
+#include <thread>
 #include <tuple>
+#include <vector>
 
 #include "args.h"
+#include "cluster.h"
 #include "densematrix.h"
 #include "dictionary.h"
+#include "eventlog.h"
+#include "halfmatrix.h"
 #include "matrix.h"
 #include "meter.h"
 #include "model.h"
 #include "real.h"
+#include "sectionstream.h"
+#include "streamqueue.h"
 #include "utils.h"
 #include "vector.h"
 
 namespace fasttext {
 
+enum class matrix_type : int8_t { dense = 0, pq, scalar };
+
+// Selects the parts of a model to load. A model loaded without one of its
+// matrices can't predict or test, and getters of the missing matrix fail.
+// Models older than version 14 always load their input matrix.
+struct LoadOptions {
+  bool input;
+  bool output;
+  // check the checksums of the loaded sections
+  bool verify;
+  // threads used to decompress sections
+  int32_t thread;
+
+  LoadOptions()
+      : input(true),
+        output(true),
+        verify(false),
+        thread(std::max(1u, std::thread::hardware_concurrency())) {}
+};
+
+struct SaveOptions {
+  bool compress;
+  // threads used to compress sections
+  int32_t thread;
+
+  SaveOptions() : compress(false), thread(1) {}
+};
+
+// The const methods of a loaded model may be called concurrently, each
+// thread passing its own Context to the inference methods that take one.
+// Loading, training, quantizing and setMatrices may not run concurrently
+// with anything else.
 class FastText {
+  friend class ModelGroup;
+
  public:
   using TrainCallback =
       std::function<void(float, float, double, double, int64_t)>;
 
+  // Scratch buffers of inference. A context is sized by its first call and
+  // reused afterwards, so that predicting doesn't allocate the vectors of a
+  // Model::State, or the token and id buffers of a line, on every call.
+  // getNN keeps its query vector and heap of neighbors in it too.
+  class Context {
+   protected:
+    friend class FastText;
+
+    std::unique_ptr<Model::State> state;
+    std::unique_ptr<Vector> vector;
+    std::vector<int32_t> words;
+    std::vector<int32_t> labels;
+    std::vector<int32_t> hashes;
+    std::string token;
+    std::string line;
+    Predictions predictions;
+
+   public:
+    Context() = default;
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+  };
+
  protected:
+  // Training state saved with a checkpoint: the number of processed tokens
+  // and, for each thread, its file offset, pending token count and
+  // Model::State.
+  struct Checkpoint {
+    int64_t tokenCount;
+    std::vector<std::string> threads;
+
+    Checkpoint() : tokenCount(0) {}
+    void save(std::ostream&) const;
+    void load(std::istream&);
+  };
+
   std::shared_ptr<Args> args_;
   std::shared_ptr<Dictionary> dict_;
   std::shared_ptr<Matrix> input_;
@@ -47,24 +127,110 @@ class FastText {
   std::chrono::steady_clock::time_point start_;
   bool quant_;
   int32_t version;
-  std::unique_ptr<DenseMatrix> wordVectors_;
+  // normalized word vectors of getNN and getAnalogies, computed on first use
+  mutable std::shared_ptr<const DenseMatrix> wordVectors_;
+  mutable std::mutex wordVectorsMutex_;
   std::exception_ptr trainException_;
+  Checkpoint checkpoint_;
+  std::mutex checkpointMutex_;
+  std::condition_variable checkpointCondition_;
+  std::atomic<bool> checkpointRequested_{};
+  int32_t checkpointPaused_;
+  int32_t checkpointFinished_;
+  int64_t checkpointGeneration_;
+  std::thread checkpointWriter_;
+  std::shared_ptr<StreamQueue> stream_;
+  std::shared_ptr<Cluster> cluster_;
+  int64_t syncs_;
+  int64_t maxSyncs_;
+  // parameters after the last averaging, with -sparseSync
+  std::unique_ptr<DenseMatrix> syncedInput_;
+  std::unique_ptr<DenseMatrix> syncedOutput_;
+  // counters merged by the training threads, with -trainStats
+  Model::Stats stats_;
+  std::mutex statsMutex_;
+  // with -events, and the tokens processed by each training thread
+  std::shared_ptr<EventLog> events_;
+  std::vector<std::atomic<int64_t>> threadTokens_;
 
   void signModel(std::ostream&);
   bool checkModel(std::istream&);
   void startThreads(const TrainCallback& callback = {});
   void addInputVector(Vector&, int32_t) const;
+  void computeWordVector(Vector&, int32_t) const;
+  void writeVectors(
+      std::ostream&,
+      int32_t,
+      const std::function<std::string(int32_t)>&,
+      const std::function<void(int32_t, Vector&)>&) const;
   void trainThread(int32_t, const TrainCallback& callback);
+  void streamThread(int32_t, const TrainCallback& callback);
+  void startCluster();
+  void syncParameters();
+  void syncRows(DenseMatrix&, DenseMatrix&);
+  void stopCluster();
+  void mergeStats(Model::Stats&);
+  void writeStats(std::ostream&, real);
+  void writeProgressEvent(real, std::vector<int64_t>&, double);
+  int32_t trainLine(
+      std::istream&,
+      Model::State&,
+      real,
+      std::vector<int32_t>&,
+      std::vector<int32_t>&);
+  std::string getThreadState(std::ifstream&, const Model::State&, int64_t)
+      const;
+  void pauseForCheckpoint(
+      int32_t,
+      std::ifstream&,
+      const Model::State&,
+      int64_t);
+  void saveCheckpoint(std::ifstream&, const Model::State&, int64_t);
+  void loadCheckpoint();
   std::vector<std::pair<real, std::string>> getNN(
       const DenseMatrix& wordVectors,
       const Vector& queryVec,
       int32_t k,
-      const std::set<std::string>& banSet);
-  void lazyComputeWordVectors();
+      const std::set<std::string>& banSet,
+      Predictions& heap) const;
+  std::shared_ptr<const DenseMatrix> lazyComputeWordVectors() const;
+  void prepareContext(Context&) const;
   void printInfo(real, real, std::ostream&);
   std::shared_ptr<Matrix> getInputMatrixFromFile(const std::string&) const;
+  std::shared_ptr<DenseMatrix> createPretrainedMatrix(
+      const std::vector<std::string>& words,
+      std::vector<int32_t>& rows) const;
+  std::shared_ptr<DenseMatrix> getInputMatrixFromText(
+      std::ifstream&,
+      const std::string&) const;
+  std::shared_ptr<DenseMatrix> getInputMatrixFromBinaryVectors(
+      std::istream&) const;
+  std::shared_ptr<DenseMatrix> getInputMatrixFromModel(
+      const std::string&) const;
+  std::shared_ptr<Matrix> loadMatrix(std::istream&, matrix_type) const;
+  void loadArgs(std::istream&);
+  void loadInput(std::istream&);
+  void loadOutput(std::istream&);
+  void loadSection(
+      std::istream&,
+      const Section&,
+      const LoadOptions&,
+      const std::function<void(std::istream&)>&);
+  void saveSections(
+      std::ofstream&,
+      const SaveOptions&,
+      const Matrix&,
+      const Matrix&,
+      const std::string&);
+  void saveFile(
+      const std::string&,
+      const std::function<void(std::ofstream&)>&) const;
+  half_type getHalfType() const;
   std::shared_ptr<Matrix> createRandomMatrix() const;
   std::shared_ptr<Matrix> createTrainOutputMatrix() const;
+  void growMatrices(int32_t nwords, int32_t nlabels);
+  void trainFromStdin(const Args& args, const TrainCallback& callback);
+  Args getDictionaryArgs(const Args& args) const;
   std::vector<int64_t> getTargetCounts() const;
   std::shared_ptr<Loss> createLoss(std::shared_ptr<Matrix>& output);
   void supervised(
@@ -74,9 +240,13 @@ class FastText {
       const std::vector<int32_t>& labels);
   void cbow(Model::State& state, real lr, const std::vector<int32_t>& line);
   void skipgram(Model::State& state, real lr, const std::vector<int32_t>& line);
-  std::vector<int32_t> selectEmbeddings(int32_t cutoff) const;
-  void precomputeWordVectors(DenseMatrix& wordVectors);
+  std::vector<int32_t> selectEmbeddings(
+      const DenseMatrix& input,
+      int32_t cutoff) const;
+  void precomputeWordVectors(DenseMatrix& wordVectors) const;
   bool keepTraining(const int64_t ntokens) const;
+  real getProgress(const int64_t ntokens) const;
+  real getLearningRate(real progress) const;
   void buildModel();
   std::tuple<int64_t, double, double> progressInfo(real progress);
 
@@ -89,8 +259,13 @@ class FastText {
 
   int32_t getLabelId(const std::string& label) const;
 
+  uint64_t getInputHash() const;
+
   void getWordVector(Vector& vec, const std::string& word) const;
 
+  void getWordVector(Vector& vec, const std::string& word, Context& context)
+      const;
+
   void getSubwordVector(Vector& vec, const std::string& subword) const;
 
   inline void getInputVector(Vector& vec, int32_t ind) {
@@ -112,15 +287,26 @@ class FastText {
 
   void saveVectors(const std::string& filename);
 
-  void saveModel(const std::string& filename);
+  void saveBinaryVectors(const std::string& filename);
+
+  void saveModel(
+      const std::string& filename,
+      const SaveOptions& options = SaveOptions());
 
   void saveOutput(const std::string& filename);
 
   void loadModel(std::istream& in);
 
-  void loadModel(const std::string& filename);
+  void loadModel(std::istream& in, const LoadOptions& options);
 
-  void getSentenceVector(std::istream& in, Vector& vec);
+  void loadModel(
+      const std::string& filename,
+      const LoadOptions& options = LoadOptions());
+
+  void getSentenceVector(std::istream& in, Vector& vec) const;
+
+  void getSentenceVector(std::istream& in, Vector& vec, Context& context)
+      const;
 
   void quantize(const Args& qargs, const TrainCallback& callback = {});
 
@@ -135,29 +321,63 @@ class FastText {
       Predictions& predictions,
       real threshold = 0.0) const;
 
+  void predict(
+      int32_t k,
+      const std::vector<int32_t>& words,
+      Predictions& predictions,
+      real threshold,
+      Context& context) const;
+
   bool predictLine(
       std::istream& in,
       std::vector<std::pair<real, std::string>>& predictions,
       int32_t k,
       real threshold) const;
 
+  bool predictLine(
+      std::istream& in,
+      std::vector<std::pair<real, std::string>>& predictions,
+      int32_t k,
+      real threshold,
+      Context& context) const;
+
+  // Same as predictLine for several lines, with a k, threshold and context
+  // each, the first lines.size() of contexts. Their hidden vectors are
+  // scored against the output matrix in one pass.
+  void predictLines(
+      const std::vector<std::string>& lines,
+      const std::vector<int32_t>& k,
+      const std::vector<real>& threshold,
+      std::vector<std::vector<std::pair<real, std::string>>>& predictions,
+      std::vector<Context>& contexts) const;
+
   std::vector<std::pair<std::string, Vector>> getNgramVectors(
       const std::string& word) const;
 
   std::vector<std::pair<real, std::string>> getNN(
       const std::string& word,
-      int32_t k);
+      int32_t k) const;
+
+  std::vector<std::pair<real, std::string>>
+  getNN(const std::string& word, int32_t k, Context& context) const;
 
   std::vector<std::pair<real, std::string>> getAnalogies(
       int32_t k,
       const std::string& wordA,
       const std::string& wordB,
-      const std::string& wordC);
+      const std::string& wordC) const;
 
   void train(const Args& args, const TrainCallback& callback = {});
 
+  void update(const Args& args, const TrainCallback& callback = {});
+
   void abort();
 
+  // Log receiving the training events, opened on the -events of the first
+  // training unless it is set.
+  void setEventLog(std::shared_ptr<EventLog> events);
+  std::shared_ptr<EventLog> getEventLog() const;
+
   int getDimension() const;
 
   bool isQuant() const;
@@ -0,0 +1,263 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "halfmatrix.h"
+
+#include <assert.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include "simd.h"
+
+namespace fasttext {
+
+namespace {
+
+// Updates are rounded stochastically: with round to nearest, updates smaller
+// than half an ulp of the parameter are lost, which stalls training.
+// Each thread owns a xorshift generator, see HalfMatrix::seedRounding.
+struct RandomState {
+  uint32_t s[8];
+  RandomState() {
+    seed(0);
+  }
+  void seed(uint32_t seed) {
+    for (int i = 0; i < 8; i++) {
+      seed = seed * 1664525 + 1013904223;
+      s[i] = seed | 1;
+    }
+  }
+};
+
+thread_local RandomState randomState;
+
+inline uint32_t nextRandom() {
+  uint32_t& x = randomState.s[0];
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+inline real nextUniform() {
+  return (nextRandom() >> 8) * (1.0f / 16777216.0f);
+}
+
+#ifdef FASTTEXT_SIMD
+inline __m256i nextRandom8() {
+  __m256i x = _mm256_loadu_si256((const __m256i*)randomState.s);
+  x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+  x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+  x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+  _mm256_storeu_si256((__m256i*)randomState.s, x);
+  return x;
+}
+
+inline __m256 load8(const uint16_t* p, half_type type) {
+  return type == half_type::fp16 ? simd::loadHalf8(p) : simd::loadBFloat8(p);
+}
+
+inline void storeStochastic8(uint16_t* p, __m256 v, half_type type) {
+  __m256i r = nextRandom8();
+  __m128i h;
+  if (type == half_type::fp16) {
+    __m128i lo = _mm256_cvtps_ph(v, _MM_FROUND_TO_ZERO);
+    __m128i hi = _mm_add_epi16(lo, _mm_set1_epi16(1));
+    __m256 flo = _mm256_cvtph_ps(lo);
+    __m256 prob = _mm256_div_ps(
+        _mm256_sub_ps(v, flo), _mm256_sub_ps(_mm256_cvtph_ps(hi), flo));
+    __m256 u = _mm256_mul_ps(
+        _mm256_cvtepi32_ps(_mm256_srli_epi32(r, 8)),
+        _mm256_set1_ps(1.0f / 16777216.0f));
+    __m256i up = _mm256_castps_si256(_mm256_cmp_ps(u, prob, _CMP_LT_OQ));
+    __m128i mask = _mm_packs_epi32(
+        _mm256_castsi256_si128(up), _mm256_extracti128_si256(up, 1));
+    h = _mm_blendv_epi8(lo, hi, mask);
+  } else {
+    __m256i x = _mm256_add_epi32(
+        _mm256_castps_si256(v),
+        _mm256_and_si256(r, _mm256_set1_epi32(0xffff)));
+    x = _mm256_srli_epi32(x, 16);
+    h = _mm_packus_epi32(
+        _mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+  }
+  _mm_storeu_si128((__m128i*)p, h);
+}
+#endif
+
+} // namespace
+
+HalfMatrix::HalfMatrix(int64_t m, int64_t n, half_type type)
+    : Matrix(m, n), type_(type), data_(m * n) {}
+
+HalfMatrix::HalfMatrix(const DenseMatrix& mat, half_type type)
+    : Matrix(mat.size(0), mat.size(1)), type_(type), data_(m_ * n_) {
+  const real* x = mat.data();
+  for (int64_t i = 0; i < m_ * n_; i++) {
+    data_[i] = encode(x[i]);
+  }
+}
+
+void HalfMatrix::seedRounding(uint32_t seed) {
+  randomState.seed(seed);
+}
+
+uint16_t HalfMatrix::encodeStochastic(real x) const {
+  if (type_ == half_type::bf16) {
+    if (std::isnan(x)) {
+      return utils::floatToBFloat16(x);
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return (bits + (nextRandom() & 0xffff)) >> 16;
+  }
+  uint16_t h = utils::floatToHalf(x);
+  real f = utils::halfToFloat(h);
+  if (f == x || std::isnan(x) || std::isinf(f)) {
+    return h;
+  }
+  if (std::abs(f) > std::abs(x)) {
+    h--; // the value just below in magnitude
+  }
+  real lo = utils::halfToFloat(h);
+  real hi = utils::halfToFloat(h + 1);
+  return (nextUniform() < (x - lo) / (hi - lo)) ? h + 1 : h;
+}
+
+void HalfMatrix::zero() {
+  std::fill(data_.begin(), data_.end(), encode(0.0));
+}
+
+void HalfMatrix::uniform(real a, unsigned int thread, int32_t seed) {
+  utils::parallelChunks(
+      m_ * n_,
+      thread,
+      seed,
+      [&](int64_t begin, int64_t end, std::minstd_rand& rng) {
+        std::uniform_real_distribution<> uniform(-a, a);
+        for (int64_t i = begin; i < end; i++) {
+          data_[i] = encode(uniform(rng));
+        }
+      });
+}
+
+DenseMatrix HalfMatrix::toDense() const {
+  DenseMatrix mat(m_, n_);
+  real* x = mat.data();
+  for (int64_t i = 0; i < m_ * n_; i++) {
+    x[i] = decode(data_[i]);
+  }
+  return mat;
+}
+
+real HalfMatrix::dotRow(const Vector& vec, int64_t i) const {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(vec.size() == n_);
+  const uint16_t* row = data_.data() + i * n_;
+  real d = 0.0;
+  int64_t j = 0;
+#ifdef FASTTEXT_SIMD
+  __m256 acc = _mm256_setzero_ps();
+  for (; j + 8 <= n_; j += 8) {
+    acc = _mm256_fmadd_ps(
+        load8(row + j, type_), _mm256_loadu_ps(vec.data() + j), acc);
+  }
+  d = simd::horizontalSum(acc);
+#endif
+  for (; j < n_; j++) {
+    d += decode(row[j]) * vec[j];
+  }
+  if (std::isnan(d)) {
+    throw DenseMatrix::EncounteredNaNError();
+  }
+  return d;
+}
+
+void HalfMatrix::addVectorToRow(const Vector& vec, int64_t i, real a) {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(vec.size() == n_);
+  uint16_t* row = data_.data() + i * n_;
+  int64_t j = 0;
+#ifdef FASTTEXT_SIMD
+  __m256 va = _mm256_set1_ps(a);
+  for (; j + 8 <= n_; j += 8) {
+    __m256 r = _mm256_fmadd_ps(
+        va, _mm256_loadu_ps(vec.data() + j), load8(row + j, type_));
+    storeStochastic8(row + j, r, type_);
+  }
+#endif
+  for (; j < n_; j++) {
+    row[j] = encodeStochastic(decode(row[j]) + a * vec[j]);
+  }
+}
+
+void HalfMatrix::addRowToVector(Vector& x, int32_t i) const {
+  addRowToVector(x, i, 1.0);
+}
+
+void HalfMatrix::addRowToVector(Vector& x, int32_t i, real a) const {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(x.size() == n_);
+  const uint16_t* row = data_.data() + i * n_;
+  int64_t j = 0;
+#ifdef FASTTEXT_SIMD
+  __m256 va = _mm256_set1_ps(a);
+  for (; j + 8 <= n_; j += 8) {
+    __m256 r = _mm256_fmadd_ps(
+        va, load8(row + j, type_), _mm256_loadu_ps(x.data() + j));
+    _mm256_storeu_ps(x.data() + j, r);
+  }
+#endif
+  for (; j < n_; j++) {
+    x[j] += a * decode(row[j]);
+  }
+}
+
+void HalfMatrix::save(std::ostream& out) const {
+  out.write((char*)&m_, sizeof(int64_t));
+  out.write((char*)&n_, sizeof(int64_t));
+  std::vector<real> row(n_);
+  for (int64_t i = 0; i < m_; i++) {
+    for (int64_t j = 0; j < n_; j++) {
+      row[j] = decode(data_[i * n_ + j]);
+    }
+    out.write((char*)row.data(), n_ * sizeof(real));
+  }
+}
+
+void HalfMatrix::load(std::istream& in) {
+  in.read((char*)&m_, sizeof(int64_t));
+  in.read((char*)&n_, sizeof(int64_t));
+  data_.resize(m_ * n_);
+  std::vector<real> row(n_);
+  for (int64_t i = 0; i < m_; i++) {
+    in.read((char*)row.data(), n_ * sizeof(real));
+    for (int64_t j = 0; j < n_; j++) {
+      data_[i * n_ + j] = encode(row[j]);
+    }
+  }
+}
+
+void HalfMatrix::dump(std::ostream& out) const {
+  out << m_ << " " << n_ << std::endl;
+  for (int64_t i = 0; i < m_; i++) {
+    for (int64_t j = 0; j < n_; j++) {
+      if (j > 0) {
+        out << " ";
+      }
+      out << decode(data_[i * n_ + j]);
+    }
+    out << std::endl;
+  }
+}
+
+} // namespace fasttext
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "real.h"
+
+#include "densematrix.h"
+#include "matrix.h"
+#include "utils.h"
+#include "vector.h"
+
+namespace fasttext {
+
+enum class half_type : int8_t { fp16 = 1, bf16 };
+
+// Dense matrix stored with 16 bits per value. Kernels decode to and
+// accumulate in `real`, so only the storage precision is reduced.
+// The matrix is saved in the DenseMatrix format. Values are left
+// uninitialized by the constructor, see zero and uniform.
+class HalfMatrix : public Matrix {
+ protected:
+  half_type type_;
+  std::vector<uint16_t, utils::DefaultInitAllocator<uint16_t>> data_;
+
+  inline uint16_t encode(real x) const {
+    return type_ == half_type::fp16 ? utils::floatToHalf(x)
+                                    : utils::floatToBFloat16(x);
+  }
+  uint16_t encodeStochastic(real) const;
+  inline real decode(uint16_t h) const {
+    return type_ == half_type::fp16 ? utils::halfToFloat(h)
+                                    : utils::bfloat16ToFloat(h);
+  }
+
+ public:
+  HalfMatrix(int64_t, int64_t, half_type);
+  HalfMatrix(const DenseMatrix&, half_type);
+  HalfMatrix(const HalfMatrix&) = delete;
+  HalfMatrix(HalfMatrix&&) = delete;
+  HalfMatrix& operator=(const HalfMatrix&) = delete;
+  HalfMatrix& operator=(HalfMatrix&&) = delete;
+  virtual ~HalfMatrix() noexcept override = default;
+
+  // Seeds the stochastic rounding of the updates made by the calling
+  // thread, so that training threads round the same way from run to run.
+  static void seedRounding(uint32_t seed);
+
+  void zero();
+  void uniform(real, unsigned int, int32_t);
+  DenseMatrix toDense() const;
+
+  real dotRow(const Vector&, int64_t) const override;
+  void addVectorToRow(const Vector&, int64_t, real) override;
+  void addRowToVector(Vector& x, int32_t i) const override;
+  void addRowToVector(Vector& x, int32_t i, real a) const override;
+  void save(std::ostream&) const override;
+  void load(std::istream&) override;
+  void dump(std::ostream&) const override;
+};
+
+} // namespace fasttext
@@ -61,6 +61,27 @@ real Loss::sigmoid(real x) const {
   }
 }
 
+// Sets the output of each state to the scores of its hidden vector, reading
+// the output matrix once for all of them.
+void Loss::scoreOutputs(const std::vector<Model::State*>& states) const {
+  if (states.empty()) {
+    return;
+  }
+  std::vector<const Vector*> hidden;
+  std::vector<Vector*> output;
+  for (Model::State* state : states) {
+    hidden.push_back(&state->hidden);
+    output.push_back(&state->output);
+  }
+  wo_->dotRowsBatch(hidden, output, states[0]->buffer);
+}
+
+void Loss::computeOutputs(const std::vector<Model::State*>& states) const {
+  for (Model::State* state : states) {
+    computeOutput(*state);
+  }
+}
+
 void Loss::predict(
     int32_t k,
     real threshold,
@@ -71,6 +92,19 @@ void Loss::predict(
   std::sort_heap(heap.begin(), heap.end(), comparePairs);
 }
 
+void Loss::predictBatch(
+    const std::vector<int32_t>& k,
+    const std::vector<real>& threshold,
+    const std::vector<Predictions*>& heaps,
+    const std::vector<Model::State*>& states) const {
+  computeOutputs(states);
+  for (size_t i = 0; i < states.size(); i++) {
+    Predictions& heap = *heaps[i];
+    findKBest(k[i], threshold[i], heap, states[i]->output);
+    std::sort_heap(heap.begin(), heap.end(), comparePairs);
+  }
+}
+
 void Loss::findKBest(
     int32_t k,
     real threshold,
@@ -114,15 +148,26 @@ real BinaryLogisticLoss::binaryLogistic(
   }
 }
 
-void BinaryLogisticLoss::computeOutput(Model::State& state) const {
-  Vector& output = state.output;
-  output.mul(*wo_, state.hidden);
+void BinaryLogisticLoss::squashOutput(Vector& output) const {
   int32_t osz = output.size();
   for (int32_t i = 0; i < osz; i++) {
     output[i] = sigmoid(output[i]);
   }
 }
 
+void BinaryLogisticLoss::computeOutput(Model::State& state) const {
+  state.output.mul(*wo_, state.hidden, state.buffer);
+  squashOutput(state.output);
+}
+
+void BinaryLogisticLoss::computeOutputs(
+    const std::vector<Model::State*>& states) const {
+  scoreOutputs(states);
+  for (Model::State* state : states) {
+    squashOutput(state->output);
+  }
+}
+
 OneVsAllLoss::OneVsAllLoss(std::shared_ptr<Matrix>& wo)
     : BinaryLogisticLoss(wo) {}
 
@@ -265,17 +310,35 @@ void HierarchicalSoftmaxLoss::predict(
     real threshold,
     Predictions& heap,
     Model::State& state) const {
-  dfs(k, threshold, 2 * osz_ - 2, 0.0, heap, state.hidden);
+  if (wo_->isRotated()) {
+    if (state.rotatedHidden.size() != state.hidden.size()) {
+      state.rotatedHidden = Vector(state.hidden.size());
+    }
+    wo_->rotate(state.hidden, state.rotatedHidden);
+  }
+  dfs(k, threshold, 2 * osz_ - 2, 0.0, heap, state);
   std::sort_heap(heap.begin(), heap.end(), comparePairs);
 }
 
+// The tree search only scores the nodes it visits, which differ between
+// states, so they are searched one by one.
+void HierarchicalSoftmaxLoss::predictBatch(
+    const std::vector<int32_t>& k,
+    const std::vector<real>& threshold,
+    const std::vector<Predictions*>& heaps,
+    const std::vector<Model::State*>& states) const {
+  for (size_t i = 0; i < states.size(); i++) {
+    predict(k[i], threshold[i], *heaps[i], *states[i]);
+  }
+}
+
 void HierarchicalSoftmaxLoss::dfs(
     int32_t k,
     real threshold,
     int32_t node,
     real score,
     Predictions& heap,
-    const Vector& hidden) const {
+    const Model::State& state) const {
   if (score < std_log(threshold)) {
     return;
   }
@@ -293,18 +356,18 @@ void HierarchicalSoftmaxLoss::dfs(
     return;
   }
 
-  real f = wo_->dotRow(hidden, node - osz_);
+  real f = wo_->isRotated()
+      ? wo_->dotRotatedRow(state.rotatedHidden, node - osz_)
+      : wo_->dotRow(state.hidden, node - osz_);
   f = 1. / (1 + std::exp(-f));
 
-  dfs(k, threshold, tree_[node].left, score + std_log(1.0 - f), heap, hidden);
-  dfs(k, threshold, tree_[node].right, score + std_log(f), heap, hidden);
+  dfs(k, threshold, tree_[node].left, score + std_log(1.0 - f), heap, state);
+  dfs(k, threshold, tree_[node].right, score + std_log(f), heap, state);
 }
 
 SoftmaxLoss::SoftmaxLoss(std::shared_ptr<Matrix>& wo) : Loss(wo) {}
 
-void SoftmaxLoss::computeOutput(Model::State& state) const {
-  Vector& output = state.output;
-  output.mul(*wo_, state.hidden);
+void SoftmaxLoss::normalizeOutput(Vector& output) const {
   real max = output[0], z = 0.0;
   int32_t osz = output.size();
   for (int32_t i = 0; i < osz; i++) {
@@ -319,6 +382,19 @@ void SoftmaxLoss::computeOutput(Model::State& state) const {
   }
 }
 
+void SoftmaxLoss::computeOutput(Model::State& state) const {
+  state.output.mul(*wo_, state.hidden, state.buffer);
+  normalizeOutput(state.output);
+}
+
+void SoftmaxLoss::computeOutputs(
+    const std::vector<Model::State*>& states) const {
+  scoreOutputs(states);
+  for (Model::State* state : states) {
+    normalizeOutput(state->output);
+  }
+}
+
 real SoftmaxLoss::forward(
     const std::vector<int32_t>& targets,
     int32_t targetIndex,
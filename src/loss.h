@@ -35,6 +35,7 @@ class Loss {
 
   real log(real x) const;
   real sigmoid(real x) const;
+  void scoreOutputs(const std::vector<Model::State*>& states) const;
 
  public:
   explicit Loss(std::shared_ptr<Matrix>& wo);
@@ -47,12 +48,20 @@ class Loss {
       real lr,
       bool backprop) = 0;
   virtual void computeOutput(Model::State& state) const = 0;
+  // Same as computeOutput for several states.
+  virtual void computeOutputs(const std::vector<Model::State*>& states) const;
 
   virtual void predict(
       int32_t /*k*/,
       real /*threshold*/,
       Predictions& /*heap*/,
       Model::State& /*state*/) const;
+  // Same as predict for several states, with a k, threshold and heap each.
+  virtual void predictBatch(
+      const std::vector<int32_t>& k,
+      const std::vector<real>& threshold,
+      const std::vector<Predictions*>& heaps,
+      const std::vector<Model::State*>& states) const;
 };
 
 class BinaryLogisticLoss : public Loss {
@@ -63,11 +72,13 @@ class BinaryLogisticLoss : public Loss {
       bool labelIsPositive,
       real lr,
       bool backprop) const;
+  void squashOutput(Vector& output) const;
 
  public:
   explicit BinaryLogisticLoss(std::shared_ptr<Matrix>& wo);
   virtual ~BinaryLogisticLoss() noexcept override = default;
   void computeOutput(Model::State& state) const override;
+  void computeOutputs(const std::vector<Model::State*>& states) const override;
 };
 
 class OneVsAllLoss : public BinaryLogisticLoss {
@@ -127,7 +138,7 @@ class HierarchicalSoftmaxLoss : public BinaryLogisticLoss {
       int32_t node,
       real score,
       Predictions& heap,
-      const Vector& hidden) const;
+      const Model::State& state) const;
 
  public:
   explicit HierarchicalSoftmaxLoss(
@@ -145,9 +156,17 @@ class HierarchicalSoftmaxLoss : public BinaryLogisticLoss {
       real threshold,
       Predictions& heap,
       Model::State& state) const override;
+  void predictBatch(
+      const std::vector<int32_t>& k,
+      const std::vector<real>& threshold,
+      const std::vector<Predictions*>& heaps,
+      const std::vector<Model::State*>& states) const override;
 };
 
 class SoftmaxLoss : public Loss {
+ protected:
+  void normalizeOutput(Vector& output) const;
+
  public:
   explicit SoftmaxLoss(std::shared_ptr<Matrix>& wo);
   ~SoftmaxLoss() noexcept override = default;
@@ -158,6 +177,7 @@ class SoftmaxLoss : public Loss {
       real lr,
       bool backprop) override;
   void computeOutput(Model::State& state) const override;
+  void computeOutputs(const std::vector<Model::State*>& states) const override;
 };
 
 } // namespace fasttext
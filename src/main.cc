@@ -6,13 +6,18 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cstdio>
 #include <iomanip>
 #include <iostream>
 #include <queue>
+#include <sstream>
 #include <stdexcept>
 #include "args.h"
 #include "autotune.h"
+#include "corpus.h"
 #include "fasttext.h"
+#include "modelgroup.h"
+#include "server.h"
 
 using namespace fasttext;
 
@@ -29,8 +34,11 @@ void printUsage() {
       << "  predict                 predict most likely labels\n"
       << "  predict-prob            predict most likely labels with "
          "probabilities\n"
+      << "  predict-group           predict with models sharing their input "
+         "matrix\n"
       << "  skipgram                train a skipgram model\n"
       << "  cbow                    train a cbow model\n"
+      << "  update                  continue training a model on new data\n"
       << "  print-word-vectors      print word vectors given a trained model\n"
       << "  print-sentence-vectors  print sentence vectors given a trained "
          "model\n"
@@ -40,6 +48,9 @@ void printUsage() {
       << "  analogies               query for analogies\n"
       << "  dump                    dump arguments,dictionary,input/output "
          "vectors\n"
+      << "  serve                   answer requests on a loaded model over a "
+         "socket\n"
+      << "  generate                write a synthetic corpus\n"
       << std::endl;
 }
 
@@ -67,6 +78,17 @@ void printPredictUsage() {
       << std::endl;
 }
 
+void printPredictGroupUsage() {
+  std::cerr
+      << "usage: fasttext predict-group <models> <test-data> [<k>] [<th>]\n\n"
+      << "  <models>     comma-separated model filenames with the same words\n"
+      << "               and input matrix\n"
+      << "  <test-data>  test data filename (if -, read from stdin)\n"
+      << "  <k>          (optional; 1 by default) predict top k labels\n"
+      << "  <th>         (optional; 0.0 by default) probability threshold\n"
+      << std::endl;
+}
+
 void printTestLabelUsage() {
   std::cerr
       << "usage: fasttext test-label <model> <test-data> [<k>] [<th>]\n\n"
@@ -96,6 +118,13 @@ void printPrintNgramsUsage() {
             << std::endl;
 }
 
+SaveOptions getSaveOptions(const Args& a) {
+  SaveOptions options;
+  options.compress = a.compress;
+  options.thread = a.thread;
+  return options;
+}
+
 void quantize(const std::vector<std::string>& args) {
   Args a = Args();
   if (args.size() < 3) {
@@ -108,7 +137,7 @@ void quantize(const std::vector<std::string>& args) {
   // parseArgs checks if a->output is given.
   fasttext.loadModel(a.output + ".bin");
   fasttext.quantize(a);
-  fasttext.saveModel(a.output + ".ftz");
+  fasttext.saveModel(a.output + ".ftz", getSaveOptions(a));
   exit(0);
 }
 
@@ -239,7 +268,8 @@ void predict(const std::vector<std::string>& args) {
   }
   std::istream& in = inputIsStdIn ? std::cin : ifs;
   std::vector<std::pair<real, std::string>> predictions;
-  while (fasttext.predictLine(in, predictions, k, threshold)) {
+  FastText::Context context;
+  while (fasttext.predictLine(in, predictions, k, threshold, context)) {
     printPredictions(predictions, printProb, false);
   }
   if (ifs.is_open()) {
@@ -249,13 +279,57 @@ void predict(const std::vector<std::string>& args) {
   exit(0);
 }
 
+// Prints the predictions of every model on a line, separated by tabs.
+void predictGroup(const std::vector<std::string>& args) {
+  if (args.size() < 4 || args.size() > 6) {
+    printPredictGroupUsage();
+    exit(EXIT_FAILURE);
+  }
+  int32_t k = args.size() > 4 ? std::stoi(args[4]) : 1;
+  real threshold = args.size() > 5 ? std::stof(args[5]) : 0.0;
+
+  ModelGroup group;
+  std::istringstream models(args[2]);
+  std::string filename;
+  while (std::getline(models, filename, ',')) {
+    group.add(filename);
+  }
+
+  std::ifstream ifs;
+  std::string infile(args[3]);
+  bool inputIsStdIn = infile == "-";
+  if (!inputIsStdIn) {
+    ifs.open(infile);
+    if (!ifs.is_open()) {
+      std::cerr << "Input file cannot be opened!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  std::istream& in = inputIsStdIn ? std::cin : ifs;
+  std::vector<std::vector<std::pair<real, std::string>>> predictions;
+  ModelGroup::Context context;
+  while (group.predictLine(in, predictions, k, threshold, context)) {
+    for (size_t i = 0; i < predictions.size(); i++) {
+      for (size_t j = 0; j < predictions[i].size(); j++) {
+        std::cout << (j > 0 ? " " : "") << predictions[i][j].second << " "
+                  << predictions[i][j].first;
+      }
+      std::cout << (i + 1 < predictions.size() ? "\t" : "\n");
+    }
+  }
+  std::cout << std::flush;
+  exit(0);
+}
+
 void printWordVectors(const std::vector<std::string> args) {
   if (args.size() != 3) {
     printPrintWordVectorsUsage();
     exit(EXIT_FAILURE);
   }
   FastText fasttext;
-  fasttext.loadModel(std::string(args[2]));
+  LoadOptions options;
+  options.output = false;
+  fasttext.loadModel(std::string(args[2]), options);
   std::string word;
   Vector vec(fasttext.getDimension());
   while (std::cin >> word) {
@@ -271,10 +345,13 @@ void printSentenceVectors(const std::vector<std::string> args) {
     exit(EXIT_FAILURE);
   }
   FastText fasttext;
-  fasttext.loadModel(std::string(args[2]));
+  LoadOptions options;
+  options.output = false;
+  fasttext.loadModel(std::string(args[2]), options);
   Vector svec(fasttext.getDimension());
+  FastText::Context context;
   while (std::cin.peek() != EOF) {
-    fasttext.getSentenceVector(std::cin, svec);
+    fasttext.getSentenceVector(std::cin, svec, context);
     // Don't print sentence
     std::cout << svec << std::endl;
   }
@@ -287,7 +364,9 @@ void printNgrams(const std::vector<std::string> args) {
     exit(EXIT_FAILURE);
   }
   FastText fasttext;
-  fasttext.loadModel(std::string(args[2]));
+  LoadOptions options;
+  options.output = false;
+  fasttext.loadModel(std::string(args[2]), options);
 
   std::string word(args[3]);
   std::vector<std::pair<std::string, Vector>> ngramVectors =
@@ -311,7 +390,9 @@ void nn(const std::vector<std::string> args) {
     exit(EXIT_FAILURE);
   }
   FastText fasttext;
-  fasttext.loadModel(std::string(args[2]));
+  LoadOptions options;
+  options.output = false;
+  fasttext.loadModel(std::string(args[2]), options);
   std::string prompt("Query word? ");
   std::cout << prompt;
 
@@ -339,7 +420,9 @@ void analogies(const std::vector<std::string> args) {
   FastText fasttext;
   std::string model(args[2]);
   std::cout << "Loading model " << model << std::endl;
-  fasttext.loadModel(model);
+  LoadOptions options;
+  options.output = false;
+  fasttext.loadModel(model, options);
 
   std::string prompt("Query triplet (A - B + C)? ");
   std::string wordA, wordB, wordC;
@@ -367,25 +450,229 @@ void train(const std::vector<std::string> args) {
   } else {
     outputFileName = a.output + ".bin";
   }
-  std::ofstream ofs(outputFileName);
-  if (!ofs.is_open()) {
-    throw std::invalid_argument(
-        outputFileName + " cannot be opened for saving.");
+  // the processes of a distributed training end with the same parameters,
+  // which process 0 saves
+  const bool save = a.rank == 0;
+  if (save) {
+    std::ofstream ofs(outputFileName);
+    if (!ofs.is_open()) {
+      throw std::invalid_argument(
+          outputFileName + " cannot be opened for saving.");
+    }
+    ofs.close();
   }
-  ofs.close();
   if (a.hasAutotune()) {
     Autotune autotune(fasttext);
     autotune.train(a);
   } else {
     fasttext->train(a);
   }
-  fasttext->saveModel(outputFileName);
+  if (!save) {
+    return;
+  }
+  fasttext->saveModel(outputFileName, getSaveOptions(a));
+  if (a.checkpoint > 0 || a.resume) {
+    std::remove((a.output + ".ckpt").c_str());
+  }
   fasttext->saveVectors(a.output + ".vec");
+  if (a.saveBinaryVectors) {
+    fasttext->saveBinaryVectors(a.output + ".vbin");
+  }
   if (a.saveOutput) {
     fasttext->saveOutput(a.output + ".output");
   }
 }
 
+void update(const std::vector<std::string>& args) {
+  Args a = Args();
+  a.parseArgs(args);
+  if (a.inputModel.empty()) {
+    std::cerr << "Empty input model path." << std::endl;
+    a.printHelp();
+    exit(EXIT_FAILURE);
+  }
+  FastText fasttext;
+  std::string outputFileName = a.output + ".bin";
+  // appending keeps the input model intact when it is also the output
+  std::ofstream ofs(outputFileName, std::ofstream::app);
+  if (!ofs.is_open()) {
+    throw std::invalid_argument(
+        outputFileName + " cannot be opened for saving.");
+  }
+  ofs.close();
+  fasttext.update(a);
+  if (a.rank != 0) {
+    return;
+  }
+  fasttext.saveModel(outputFileName, getSaveOptions(a));
+  fasttext.saveVectors(a.output + ".vec");
+  if (a.saveBinaryVectors) {
+    fasttext.saveBinaryVectors(a.output + ".vbin");
+  }
+  if (a.saveOutput) {
+    fasttext.saveOutput(a.output + ".output");
+  }
+}
+
+void printServeUsage() {
+  std::cout
+      << "usage: fasttext serve <model> <address> [<thread>] [<batch>]\n\n"
+      << "  <model>      model filename\n"
+      << "  <address>    host:port or unix:<socket path>, reload requests "
+         "are only\n"
+      << "               accepted on a unix socket\n"
+      << "  <thread>     (optional; 4 by default) number of threads\n"
+      << "  <batch>      (optional; 16 by default) max predict requests "
+         "scored\n"
+      << "               together by a thread\n"
+      << std::endl;
+}
+
+void serve(const std::vector<std::string>& args) {
+  if (args.size() < 4 || args.size() > 6) {
+    printServeUsage();
+    exit(EXIT_FAILURE);
+  }
+  int32_t thread = args.size() > 4 ? std::stoi(args[4]) : 4;
+  int32_t batch = args.size() > 5 ? std::stoi(args[5]) : 16;
+  auto fasttext = std::make_shared<FastText>();
+  fasttext->loadModel(std::string(args[2]));
+  Server server(std::make_shared<ModelHolder>(fasttext), thread, batch);
+  server.serve(args[3]);
+}
+
+void printGenerateUsage() {
+  CorpusOptions options;
+  std::cerr
+      << "usage: fasttext generate <output> <args>\n\n"
+      << "  <output>        training file, or - for stdout\n\n"
+      << "  -size           bytes of the training file, with a K, M, G or T "
+         "suffix [1M]\n"
+      << "  -lines          lines of the training file, instead of -size [0]\n"
+      << "  -test           file receiving test lines of the same "
+         "distribution []\n"
+      << "  -testLines      lines of the test file [10000]\n"
+      << "  -words          size of the vocabulary [" << options.words << "]\n"
+      << "  -zipf           exponent of word frequencies by rank ["
+      << options.zipf << "]\n"
+      << "  -labels         number of labels, 0 for no labels ["
+      << options.labels << "]\n"
+      << "  -labelsPerLine  labels of a line [" << options.labelsPerLine
+      << "]\n"
+      << "  -labelZipf      exponent of label frequencies by rank ["
+      << options.labelZipf << "]\n"
+      << "  -label          labels prefix [" << options.label << "]\n"
+      << "  -topic          probability of a word to depend on the first label "
+         "of its line ["
+      << options.topic << "]\n"
+      << "  -meanLength     mean words by line [" << options.meanLength
+      << "]\n"
+      << "  -lengthSigma    sigma of the log-normal words by line, 0 for fixed "
+         "lengths ["
+      << options.lengthSigma << "]\n"
+      << "  -maxLength      max words by line [" << options.maxLength << "]\n"
+      << "  -utf8           fraction of words in multi-byte characters ["
+      << options.utf8 << "]\n"
+      << "  -seed           random generator seed [" << options.seed << "]\n"
+      << std::endl;
+}
+
+// Writes a corpus of a given size, reporting progress on large ones.
+void generate(const std::vector<std::string>& args) {
+  if (args.size() < 3 || args.size() % 2 == 0) {
+    printGenerateUsage();
+    exit(EXIT_FAILURE);
+  }
+  CorpusOptions options;
+  int64_t size = 1 << 20;
+  int64_t lines = 0;
+  int64_t testLines = 10000;
+  std::string test;
+  for (size_t ai = 3; ai < args.size(); ai += 2) {
+    const std::string& value = args[ai + 1];
+    if (args[ai] == "-size") {
+      size = CorpusGenerator::parseSize(value);
+    } else if (args[ai] == "-lines") {
+      lines = std::stoll(value);
+    } else if (args[ai] == "-test") {
+      test = value;
+    } else if (args[ai] == "-testLines") {
+      testLines = std::stoll(value);
+    } else if (args[ai] == "-words") {
+      options.words = std::stoi(value);
+    } else if (args[ai] == "-zipf") {
+      options.zipf = std::stod(value);
+    } else if (args[ai] == "-labels") {
+      options.labels = std::stoi(value);
+    } else if (args[ai] == "-labelsPerLine") {
+      options.labelsPerLine = std::stoi(value);
+    } else if (args[ai] == "-labelZipf") {
+      options.labelZipf = std::stod(value);
+    } else if (args[ai] == "-label") {
+      options.label = value;
+    } else if (args[ai] == "-topic") {
+      options.topic = std::stod(value);
+    } else if (args[ai] == "-meanLength") {
+      options.meanLength = std::stod(value);
+    } else if (args[ai] == "-lengthSigma") {
+      options.lengthSigma = std::stod(value);
+    } else if (args[ai] == "-maxLength") {
+      options.maxLength = std::stoi(value);
+    } else if (args[ai] == "-utf8") {
+      options.utf8 = std::stod(value);
+    } else if (args[ai] == "-seed") {
+      options.seed = std::stoi(value);
+    } else {
+      std::cerr << "Unknown argument: " << args[ai] << std::endl;
+      printGenerateUsage();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  std::ofstream ofs;
+  bool outputIsStdOut = args[2] == "-";
+  if (!outputIsStdOut) {
+    ofs.open(args[2]);
+    if (!ofs.is_open()) {
+      std::cerr << "Output file cannot be opened!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  std::ostream& out = outputIsStdOut ? std::cout : ofs;
+  CorpusGenerator generator(options);
+  if (lines > 0) {
+    generator.write(out, lines, 0);
+  } else {
+    const int64_t chunk = int64_t(1) << 28;
+    int64_t written = 0;
+    while (written < size) {
+      written += generator.write(out, 0, std::min(chunk, size - written));
+      if (size > chunk) {
+        std::cerr << "\rWritten: " << (written >> 20) << "M" << std::flush;
+      }
+    }
+    if (size > chunk) {
+      std::cerr << std::endl;
+    }
+  }
+  out.flush();
+  if (!out) {
+    std::cerr << "Error writing the corpus!" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  if (!test.empty() && testLines > 0) {
+    // the test lines don't depend on the size of the training file
+    options.seed++;
+    CorpusGenerator testGenerator(options);
+    std::ofstream testOut(test);
+    testGenerator.write(testOut, testLines, 0);
+    if (!testOut) {
+      std::cerr << "Error writing the test file!" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
 void dump(const std::vector<std::string>& args) {
   if (args.size() < 4) {
     printDumpUsage();
@@ -396,7 +683,10 @@ void dump(const std::vector<std::string>& args) {
   std::string option = args[3];
 
   FastText fasttext;
-  fasttext.loadModel(modelPath);
+  LoadOptions options;
+  options.input = option == "input";
+  options.output = option == "output";
+  fasttext.loadModel(modelPath, options);
   if (option == "args") {
     fasttext.getArgs().dump(std::cout);
   } else if (option == "dict") {
@@ -444,8 +734,16 @@ int main(int argc, char** argv) {
     analogies(args);
   } else if (command == "predict" || command == "predict-prob") {
     predict(args);
+  } else if (command == "predict-group") {
+    predictGroup(args);
+  } else if (command == "update") {
+    update(args);
   } else if (command == "dump") {
     dump(args);
+  } else if (command == "serve") {
+    serve(args);
+  } else if (command == "generate") {
+    generate(args);
   } else {
     printUsage();
     exit(EXIT_FAILURE);
@@ -8,6 +8,8 @@
 
 #include "matrix.h"
 
+#include "vector.h"
+
 namespace fasttext {
 
 Matrix::Matrix() : m_(0), n_(0) {}
@@ -22,4 +24,60 @@ int64_t Matrix::size(int64_t dim) const {
   return n_;
 }
 
+void Matrix::dotRows(const Vector& vec, Vector& out) const {
+  assert(vec.size() == n_);
+  assert(out.size() == m_);
+  for (int64_t i = 0; i < m_; i++) {
+    out[i] = dotRow(vec, i);
+  }
+}
+
+void Matrix::dotRows(
+    const Vector& vec,
+    Vector& out,
+    std::vector<real>& /* unused */) const {
+  dotRows(vec, out);
+}
+
+// Each row is read once for all the vectors, instead of once per vector.
+void Matrix::dotRowsBatch(
+    const std::vector<const Vector*>& vecs,
+    const std::vector<Vector*>& outs,
+    std::vector<real>& /* unused */) const {
+  assert(vecs.size() == outs.size());
+  for (int64_t i = 0; i < m_; i++) {
+    for (size_t j = 0; j < vecs.size(); j++) {
+      (*outs[j])[i] = dotRow(*vecs[j], i);
+    }
+  }
+}
+
+void Matrix::addVectorToRows(
+    const Vector& vec,
+    const std::vector<int32_t>& rows,
+    real a) {
+  for (auto it = rows.cbegin(); it != rows.cend(); ++it) {
+    addVectorToRow(vec, *it, a);
+  }
+}
+
+void Matrix::addRowsToVector(Vector& x, const std::vector<int32_t>& rows)
+    const {
+  for (auto it = rows.cbegin(); it != rows.cend(); ++it) {
+    addRowToVector(x, *it);
+  }
+}
+
+bool Matrix::isRotated() const {
+  return false;
+}
+
+void Matrix::rotate(const Vector& x, Vector& rx) const {
+  rx = x;
+}
+
+real Matrix::dotRotatedRow(const Vector& rx, int64_t i) const {
+  return dotRow(rx, i);
+}
+
 } // namespace fasttext
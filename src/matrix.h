@@ -33,9 +33,29 @@ class Matrix {
   int64_t size(int64_t dim) const;
 
   virtual real dotRow(const Vector&, int64_t) const = 0;
+  virtual void dotRows(const Vector&, Vector&) const;
+  // Same as dotRows, with a buffer the matrix may reuse between calls.
+  virtual void
+  dotRows(const Vector&, Vector&, std::vector<real>& buffer) const;
+  // Same as dotRows for several vectors, scored in one pass over the rows.
+  virtual void dotRowsBatch(
+      const std::vector<const Vector*>&,
+      const std::vector<Vector*>&,
+      std::vector<real>& buffer) const;
   virtual void addVectorToRow(const Vector&, int64_t, real) = 0;
+  virtual void
+  addVectorToRows(const Vector&, const std::vector<int32_t>& rows, real);
   virtual void addRowToVector(Vector& x, int32_t i) const = 0;
   virtual void addRowToVector(Vector& x, int32_t i, real a) const = 0;
+  virtual void addRowsToVector(Vector& x, const std::vector<int32_t>& rows)
+      const;
+  // Rotated quantized matrices keep their rows in a rotated basis. Callers
+  // scoring many rows with the same vector rotate it once and use
+  // dotRotatedRow. For other matrices, rotating is a copy and dotRotatedRow
+  // is dotRow.
+  virtual bool isRotated() const;
+  virtual void rotate(const Vector& x, Vector& rx) const;
+  virtual real dotRotatedRow(const Vector& rx, int64_t i) const;
   virtual void save(std::ostream&) const = 0;
   virtual void load(std::istream&) = 0;
   virtual void dump(std::ostream&) const = 0;
@@ -11,17 +11,56 @@
 #include "utils.h"
 
 #include <algorithm>
+#include <chrono>
 #include <stdexcept>
 
 namespace fasttext {
 
+namespace {
+
+// Adds the nanoseconds elapsed since `start` to `time` and restarts.
+void lap(int64_t& time, std::chrono::steady_clock::time_point& start) {
+  auto now = std::chrono::steady_clock::now();
+  time += std::chrono::duration_cast<std::chrono::nanoseconds>(now - start)
+              .count();
+  start = now;
+}
+
+} // namespace
+
+Model::Stats::Stats()
+    : lines(0),
+      skippedLines(0),
+      tokens(0),
+      discardedTokens(0),
+      updates(0),
+      tokenizeTime(0),
+      hiddenTime(0),
+      lossTime(0),
+      gradientTime(0) {}
+
+void Model::Stats::add(const Stats& other) {
+  lines += other.lines;
+  skippedLines += other.skippedLines;
+  tokens += other.tokens;
+  discardedTokens += other.discardedTokens;
+  updates += other.updates;
+  tokenizeTime += other.tokenizeTime;
+  hiddenTime += other.hiddenTime;
+  lossTime += other.lossTime;
+  gradientTime += other.gradientTime;
+}
+
 Model::State::State(int32_t hiddenSize, int32_t outputSize, int32_t seed)
     : lossValue_(0.0),
       nexamples_(0),
       hidden(hiddenSize),
       output(outputSize),
       grad(hiddenSize),
-      rng(seed) {}
+      buffer(),
+      rotatedHidden(0),
+      rng(seed),
+      stats(nullptr) {}
 
 real Model::State::getLoss() const {
   return lossValue_ / nexamples_;
@@ -32,6 +71,19 @@ void Model::State::incrementNExamples(real loss) {
   nexamples_++;
 }
 
+void Model::State::save(std::ostream& out) const {
+  out.write((char*)&lossValue_, sizeof(real));
+  out.write((char*)&nexamples_, sizeof(int64_t));
+  out << rng << std::ends;
+}
+
+void Model::State::load(std::istream& in) {
+  in.read((char*)&lossValue_, sizeof(real));
+  in.read((char*)&nexamples_, sizeof(int64_t));
+  in >> rng;
+  in.get();
+}
+
 Model::Model(
     std::shared_ptr<Matrix> wi,
     std::shared_ptr<Matrix> wo,
@@ -43,9 +95,7 @@ void Model::computeHidden(const std::vector<int32_t>& input, State& state)
     const {
   Vector& hidden = state.hidden;
   hidden.zero();
-  for (auto it = input.cbegin(); it != input.cend(); ++it) {
-    hidden.addRow(*wi_, *it);
-  }
+  wi_->addRowsToVector(hidden, input);
   hidden.mul(1.0 / input.size());
 }
 
@@ -55,17 +105,44 @@ void Model::predict(
     real threshold,
     Predictions& heap,
     State& state) const {
+  computeHidden(input, state);
+  predictHidden(k, threshold, heap, state);
+}
+
+void Model::predictHidden(
+    int32_t k,
+    real threshold,
+    Predictions& heap,
+    State& state) const {
   if (k == Model::kUnlimitedPredictions) {
     k = wo_->size(0); // output size
   } else if (k <= 0) {
     throw std::invalid_argument("k needs to be 1 or higher!");
   }
   heap.reserve(k + 1);
-  computeHidden(input, state);
 
   loss_->predict(k, threshold, heap, state);
 }
 
+void Model::predictBatch(
+    const std::vector<const std::vector<int32_t>*>& inputs,
+    std::vector<int32_t> k,
+    const std::vector<real>& threshold,
+    const std::vector<Predictions*>& heaps,
+    const std::vector<State*>& states) const {
+  for (size_t i = 0; i < inputs.size(); i++) {
+    if (k[i] == Model::kUnlimitedPredictions) {
+      k[i] = wo_->size(0); // output size
+    } else if (k[i] <= 0) {
+      throw std::invalid_argument("k needs to be 1 or higher!");
+    }
+    heaps[i]->reserve(k[i] + 1);
+    computeHidden(*inputs[i], *states[i]);
+  }
+
+  loss_->predictBatch(k, threshold, heaps, states);
+}
+
 void Model::update(
     const std::vector<int32_t>& input,
     const std::vector<int32_t>& targets,
@@ -75,18 +152,31 @@ void Model::update(
   if (input.size() == 0) {
     return;
   }
+  Stats* stats = state.stats;
+  std::chrono::steady_clock::time_point start;
+  if (stats) {
+    stats->updates++;
+    start = std::chrono::steady_clock::now();
+  }
   computeHidden(input, state);
+  if (stats) {
+    lap(stats->hiddenTime, start);
+  }
 
   Vector& grad = state.grad;
   grad.zero();
   real lossValue = loss_->forward(targets, targetIndex, state, lr, true);
   state.incrementNExamples(lossValue);
+  if (stats) {
+    lap(stats->lossTime, start);
+  }
 
   if (normalizeGradient_) {
     grad.mul(1.0 / input.size());
   }
-  for (auto it = input.cbegin(); it != input.cend(); ++it) {
-    wi_->addVectorToRow(grad, *it, 1.0);
+  wi_->addVectorToRows(grad, input, 1.0);
+  if (stats) {
+    lap(stats->gradientTime, start);
   }
 }
 
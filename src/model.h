@@ -8,7 +8,9 @@
 
 #pragma once
 
+#include <istream>
 #include <memory>
+#include <ostream>
 #include <random>
 #include <utility>
 #include <vector>
@@ -40,6 +42,23 @@ class Model {
   Model& operator=(const Model& other) = delete;
   Model& operator=(Model&& other) = delete;
 
+  // Counters of a training thread. Times are in nanoseconds, the loss
+  // time covering both its forward and backward passes.
+  struct Stats {
+    int64_t lines;
+    int64_t skippedLines;
+    int64_t tokens;
+    int64_t discardedTokens;
+    int64_t updates;
+    int64_t tokenizeTime;
+    int64_t hiddenTime;
+    int64_t lossTime;
+    int64_t gradientTime;
+
+    Stats();
+    void add(const Stats&);
+  };
+
   class State {
    private:
     real lossValue_;
@@ -49,11 +68,20 @@ class Model {
     Vector hidden;
     Vector output;
     Vector grad;
+    // reused by the output matrix to score the hidden vector
+    std::vector<real> buffer;
+    // hidden in the basis of the rows of a rotated output matrix, sized by
+    // the hierarchical softmax prediction which uses it
+    Vector rotatedHidden;
     std::minstd_rand rng;
+    // if set, updates add their counts and times to it
+    Stats* stats;
 
     State(int32_t hiddenSize, int32_t outputSize, int32_t seed);
     real getLoss() const;
     void incrementNExamples(real loss);
+    void save(std::ostream&) const;
+    void load(std::istream&);
   };
 
   void predict(
@@ -62,6 +90,21 @@ class Model {
       real threshold,
       Predictions& heap,
       State& state) const;
+  // Same as predict, once the hidden vector of the state is computed.
+  void predictHidden(
+      int32_t k,
+      real threshold,
+      Predictions& heap,
+      State& state) const;
+  // Same as predict for several inputs, with a k, threshold, heap and state
+  // each. Their hidden vectors are scored against the output matrix
+  // together.
+  void predictBatch(
+      const std::vector<const std::vector<int32_t>*>& inputs,
+      std::vector<int32_t> k,
+      const std::vector<real>& threshold,
+      const std::vector<Predictions*>& heaps,
+      const std::vector<State*>& states) const;
   void update(
       const std::vector<int32_t>& input,
       const std::vector<int32_t>& targets,
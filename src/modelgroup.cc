@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "modelgroup.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace fasttext {
+
+ModelGroup::ModelGroup() : hash_(0) {}
+
+void ModelGroup::add(
+    const std::string& filename,
+    const LoadOptions& options) {
+  auto fasttext = std::make_shared<FastText>();
+  fasttext->loadModel(filename, options);
+  if (fasttext->args_->model != model_name::sup) {
+    throw std::invalid_argument(filename + " is not a supervised model!");
+  }
+  if (!fasttext->model_) {
+    throw std::invalid_argument(filename + " was loaded without its matrices!");
+  }
+  // pruned dictionaries map their subwords to rows of their own
+  if (fasttext->dict_->isPruned()) {
+    throw std::invalid_argument(
+        filename + " has a pruned dictionary and can't share its input!");
+  }
+  uint64_t hash = fasttext->getInputHash();
+  if (!base_) {
+    base_ = fasttext;
+    hash_ = hash;
+  } else if (hash != hash_) {
+    throw std::invalid_argument(
+        filename + " doesn't have the words and input matrix of " +
+        members_[0]->name + "!");
+  }
+  std::unique_ptr<Member> member(new Member());
+  member->name = filename;
+  member->output = fasttext->output_;
+  if (fasttext == base_) {
+    member->model = fasttext->model_;
+  } else {
+    // the input matrix and dictionary of the model are freed on return
+    member->model = std::make_shared<Model>(
+        base_->input_,
+        member->output,
+        fasttext->createLoss(member->output),
+        true);
+  }
+  for (int32_t i = 0; i < fasttext->dict_->nlabels(); i++) {
+    member->labels.push_back(fasttext->dict_->getLabel(i));
+  }
+  members_.push_back(std::move(member));
+}
+
+void ModelGroup::prepareContext(Context& context) const {
+  context.states.resize(members_.size());
+  for (size_t i = 0; i < members_.size(); i++) {
+    auto& state = context.states[i];
+    if (!state || state->hidden.size() != base_->args_->dim ||
+        state->output.size() != members_[i]->labels.size()) {
+      state = std::unique_ptr<Model::State>(new Model::State(
+          base_->args_->dim, members_[i]->labels.size(), 0));
+    }
+  }
+}
+
+bool ModelGroup::predictLine(
+    std::istream& in,
+    std::vector<std::vector<std::pair<real, std::string>>>& predictions,
+    int32_t k,
+    real threshold,
+    Context& context) const {
+  predictions.resize(members_.size());
+  for (auto& p : predictions) {
+    p.clear();
+  }
+  if (in.peek() == EOF) {
+    return false;
+  }
+  if (!base_) {
+    throw std::invalid_argument("The group has no model!");
+  }
+
+  base_->dict_->getLine(
+      in, context.words, context.labels, context.hashes, context.token);
+  if (context.words.empty()) {
+    return true;
+  }
+  prepareContext(context);
+  members_[0]->model->computeHidden(context.words, *context.states[0]);
+  for (size_t i = 0; i < members_.size(); i++) {
+    Model::State& state = *context.states[i];
+    if (i > 0) {
+      state.hidden = context.states[0]->hidden;
+    }
+    context.predictions.clear();
+    members_[i]->model->predictHidden(
+        k, threshold, context.predictions, state);
+    for (const auto& p : context.predictions) {
+      predictions[i].push_back(
+          std::make_pair(std::exp(p.first), members_[i]->labels[p.second]));
+    }
+  }
+  return true;
+}
+
+} // namespace fasttext
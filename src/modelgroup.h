@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "args.h"
+#include "fasttext.h"
+#include "model.h"
+#include "real.h"
+
+namespace fasttext {
+
+// Supervised models with the same words and input matrix, for instance
+// trained from the same pretrained vectors, but with their own labels. The
+// dictionary and input matrix of the first model are shared by all of
+// them, which keep only their output matrix and labels, and the hidden
+// vector of a line is computed once for all the models. getInputHash()
+// checks that the models can share their input.
+class ModelGroup {
+ public:
+  // Scratch buffers of predictLine, one per calling thread.
+  class Context {
+   protected:
+    friend class ModelGroup;
+
+    std::vector<std::unique_ptr<Model::State>> states;
+    std::vector<int32_t> words;
+    std::vector<int32_t> labels;
+    std::vector<int32_t> hashes;
+    std::string token;
+    Predictions predictions;
+
+   public:
+    Context() = default;
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+  };
+
+ protected:
+  // Losses refer to their output matrix, so members don't move.
+  struct Member {
+    std::string name;
+    std::shared_ptr<Matrix> output;
+    std::shared_ptr<Model> model;
+    std::vector<std::string> labels;
+  };
+
+  std::shared_ptr<FastText> base_;
+  uint64_t hash_;
+  std::vector<std::unique_ptr<Member>> members_;
+
+  void prepareContext(Context&) const;
+
+ public:
+  ModelGroup();
+  ModelGroup(const ModelGroup&) = delete;
+  ModelGroup& operator=(const ModelGroup&) = delete;
+
+  // Adds a model, which must have the words and input matrix of the
+  // first one.
+  void add(
+      const std::string& filename,
+      const LoadOptions& options = LoadOptions());
+
+  int32_t size() const {
+    return members_.size();
+  }
+  const std::string& getName(int32_t i) const {
+    return members_[i]->name;
+  }
+
+  // Predicts the labels of a line with every model, in the order they
+  // were added.
+  bool predictLine(
+      std::istream& in,
+      std::vector<std::vector<std::pair<real, std::string>>>& predictions,
+      int32_t k,
+      real threshold,
+      Context& context) const;
+};
+
+} // namespace fasttext
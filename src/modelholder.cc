@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "modelholder.h"
+
+#include <stdexcept>
+
+namespace fasttext {
+
+ModelHolder::ModelHolder(std::shared_ptr<const FastText> model)
+    : model_(model) {
+  if (!model_) {
+    throw std::invalid_argument("ModelHolder needs a model!");
+  }
+}
+
+std::shared_ptr<const FastText> ModelHolder::get() const {
+  std::lock_guard<std::mutex> lock(modelMutex_);
+  return model_;
+}
+
+void ModelHolder::set(std::shared_ptr<const FastText> model) {
+  if (!model) {
+    throw std::invalid_argument("ModelHolder needs a model!");
+  }
+  // the previous model is freed by its last reader, outside of the lock
+  std::shared_ptr<const FastText> previous;
+  std::lock_guard<std::mutex> lock(modelMutex_);
+  previous.swap(model_);
+  model_ = model;
+}
+
+void ModelHolder::reload(
+    const std::string& filename,
+    const LoadOptions& options) {
+  // concurrent reloads would only hold several models in memory at once
+  std::lock_guard<std::mutex> lock(reloadMutex_);
+  auto model = std::make_shared<FastText>();
+  model->loadModel(filename, options);
+  set(model);
+}
+
+} // namespace fasttext
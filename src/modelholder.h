@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "fasttext.h"
+
+namespace fasttext {
+
+// Holds the current model of a service so that it can be replaced while
+// it is used. get() returns a snapshot which stays valid as long as the
+// caller keeps it, so in-flight requests finish on the model they started
+// with while new ones get the replacement.
+//
+// A request sees the model current when it calls get(), not when it was
+// queued: while a reload is loading, the requests started meanwhile, even
+// those sent after the reload on the same connection, get the previous
+// model. Only the requests started after reload() returns, such as those a
+// client sends once it got the answer of the reload, see the new one.
+class ModelHolder {
+ protected:
+  std::shared_ptr<const FastText> model_;
+  mutable std::mutex modelMutex_;
+  std::mutex reloadMutex_;
+
+ public:
+  explicit ModelHolder(std::shared_ptr<const FastText> model);
+  ModelHolder(const ModelHolder&) = delete;
+  ModelHolder& operator=(const ModelHolder&) = delete;
+
+  std::shared_ptr<const FastText> get() const;
+  void set(std::shared_ptr<const FastText> model);
+  // Loads a model and swaps it in. Readers don't wait for the load, which
+  // happens in the calling thread; if it fails, the current model is kept.
+  void reload(
+      const std::string& filename,
+      const LoadOptions& options = LoadOptions());
+};
+
+} // namespace fasttext
@@ -8,6 +8,8 @@
 
 #include "productquantizer.h"
 
+#include <assert.h>
+
 #include <algorithm>
 #include <iostream>
 #include <numeric>
@@ -53,6 +55,14 @@ real* ProductQuantizer::get_centroids(int32_t m, uint8_t i) {
   return &centroids_[(m * ksub_ + i) * dsub_];
 }
 
+int32_t ProductQuantizer::get_ksub() const {
+  return ksub_;
+}
+
+int64_t ProductQuantizer::get_dot_table_size() const {
+  return int64_t(nsubq_) * ksub_;
+}
+
 real ProductQuantizer::assign_centroid(
     const real* x,
     const real* c0,
@@ -179,6 +189,15 @@ real ProductQuantizer::mulcode(
     const uint8_t* codes,
     int32_t t,
     real alpha) const {
+  assert(x.size() == dim_);
+  return mulcode(x.data(), codes, t, alpha);
+}
+
+real ProductQuantizer::mulcode(
+    const real* x,
+    const uint8_t* codes,
+    int32_t t,
+    real alpha) const {
   real res = 0.0;
   auto d = dsub_;
   const uint8_t* code = codes + nsubq_ * t;
@@ -194,6 +213,45 @@ real ProductQuantizer::mulcode(
   return res * alpha;
 }
 
+real ProductQuantizer::mulcode_table(
+    const real* table,
+    const uint8_t* codes,
+    int32_t t,
+    real alpha) const {
+  real res = 0.0;
+  const uint8_t* code = codes + nsubq_ * t;
+  const real* tm = table;
+  for (auto m = 0; m < nsubq_; m++) {
+    res += tm[code[m]];
+    tm += ksub_;
+  }
+  return res * alpha;
+}
+
+// Asymmetric distance computation: table[m * ksub_ + k] holds the dot
+// product between the m-th sub-vector of x and the k-th centroid of the
+// m-th sub-quantizer, so that scoring a row only needs nsubq_ lookups.
+// The table has get_dot_table_size() entries.
+void ProductQuantizer::compute_dot_table(const real* x, real* table) const {
+  auto d = dsub_;
+  for (auto m = 0; m < nsubq_; m++) {
+    if (m == nsubq_ - 1) {
+      d = lastdsub_;
+    }
+    const real* xm = x + m * dsub_;
+    const real* c = get_centroids(m, 0);
+    real* tm = table + m * ksub_;
+    for (auto k = 0; k < ksub_; k++) {
+      real dot = 0.0;
+      for (auto n = 0; n < d; n++) {
+        dot += xm[n] * c[n];
+      }
+      tm[k] = dot;
+      c += d;
+    }
+  }
+}
+
 void ProductQuantizer::addcode(
     Vector& x,
     const uint8_t* codes,
@@ -212,6 +270,26 @@ void ProductQuantizer::addcode(
   }
 }
 
+// Straight-through update: the gradient of a row is applied to the
+// centroids it is encoded with.
+void ProductQuantizer::update_centroids(
+    const Vector& x,
+    const uint8_t* codes,
+    int32_t t,
+    real alpha) {
+  auto d = dsub_;
+  const uint8_t* code = codes + nsubq_ * t;
+  for (auto m = 0; m < nsubq_; m++) {
+    real* c = get_centroids(m, code[m]);
+    if (m == nsubq_ - 1) {
+      d = lastdsub_;
+    }
+    for (auto n = 0; n < d; n++) {
+      c[n] += alpha * x[m * dsub_ + n];
+    }
+  }
+}
+
 void ProductQuantizer::compute_code(const real* x, uint8_t* code) const {
   auto d = dsub_;
   for (auto m = 0; m < nsubq_; m++) {
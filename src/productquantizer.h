@@ -44,6 +44,8 @@ class ProductQuantizer {
 
   real* get_centroids(int32_t, uint8_t);
   const real* get_centroids(int32_t, uint8_t) const;
+  int32_t get_ksub() const;
+  int64_t get_dot_table_size() const;
 
   real assign_centroid(const real*, const real*, uint8_t*, int32_t) const;
   void Estep(const real*, const real*, uint8_t*, int32_t, int32_t) const;
@@ -52,7 +54,11 @@ class ProductQuantizer {
   void train(int, const real*);
 
   real mulcode(const Vector&, const uint8_t*, int32_t, real) const;
+  real mulcode(const real*, const uint8_t*, int32_t, real) const;
+  real mulcode_table(const real*, const uint8_t*, int32_t, real) const;
+  void compute_dot_table(const real*, real*) const;
   void addcode(Vector&, const uint8_t*, int32_t, real) const;
+  void update_centroids(const Vector&, const uint8_t*, int32_t, real);
   void compute_code(const real*, uint8_t*) const;
   void compute_codes(const real*, uint8_t*, int32_t) const;
 
@@ -9,14 +9,22 @@
 #include "quantmatrix.h"
 
 #include <assert.h>
+#include <cmath>
 #include <iostream>
+#include <random>
 #include <stdexcept>
 
 namespace fasttext {
 
+constexpr int32_t kRotationSeed = 1234;
+
 QuantMatrix::QuantMatrix() : Matrix(), qnorm_(false), codesize_(0) {}
 
-QuantMatrix::QuantMatrix(DenseMatrix&& mat, int32_t dsub, bool qnorm)
+QuantMatrix::QuantMatrix(
+    DenseMatrix&& mat,
+    int32_t dsub,
+    bool qnorm,
+    bool rotate)
     : Matrix(mat.size(0), mat.size(1)),
       qnorm_(qnorm),
       codesize_(mat.size(0) * ((mat.size(1) + dsub - 1) / dsub)) {
@@ -26,9 +34,89 @@ QuantMatrix::QuantMatrix(DenseMatrix&& mat, int32_t dsub, bool qnorm)
     norm_codes_.resize(m_);
     npq_ = std::unique_ptr<ProductQuantizer>(new ProductQuantizer(1, 1));
   }
+  if (rotate) {
+    initRotation();
+  }
   quantize(std::forward<DenseMatrix>(mat));
 }
 
+// Draws a random orthogonal matrix by orthonormalizing the rows of a
+// gaussian matrix. Rotating the rows before product quantization spreads
+// the variance evenly across sub-vectors.
+void QuantMatrix::initRotation() {
+  std::minstd_rand rng(kRotationSeed);
+  std::normal_distribution<> normal(0.0, 1.0);
+  std::vector<double> r(n_ * n_);
+  for (auto& v : r) {
+    v = normal(rng);
+  }
+  for (int64_t i = 0; i < n_; i++) {
+    double* ri = r.data() + i * n_;
+    for (int64_t j = 0; j < i; j++) {
+      const double* rj = r.data() + j * n_;
+      double dot = 0.0;
+      for (int64_t k = 0; k < n_; k++) {
+        dot += ri[k] * rj[k];
+      }
+      for (int64_t k = 0; k < n_; k++) {
+        ri[k] -= dot * rj[k];
+      }
+    }
+    double norm = 0.0;
+    for (int64_t k = 0; k < n_; k++) {
+      norm += ri[k] * ri[k];
+    }
+    norm = std::sqrt(norm);
+    for (int64_t k = 0; k < n_; k++) {
+      ri[k] /= norm;
+    }
+  }
+  rotation_.assign(r.begin(), r.end());
+}
+
+// y = R x
+void QuantMatrix::rotate(const real* x, real* y) const {
+  const real* ri = rotation_.data();
+  for (int64_t i = 0; i < n_; i++) {
+    real d = 0.0;
+    for (int64_t k = 0; k < n_; k++) {
+      d += ri[k] * x[k];
+    }
+    y[i] = d;
+    ri += n_;
+  }
+}
+
+// x += R^T y
+void QuantMatrix::unrotate(const real* y, real* x) const {
+  const real* ri = rotation_.data();
+  for (int64_t i = 0; i < n_; i++) {
+    for (int64_t k = 0; k < n_; k++) {
+      x[k] += ri[k] * y[i];
+    }
+    ri += n_;
+  }
+}
+
+void QuantMatrix::rotateRows(DenseMatrix& mat) const {
+  if (rotation_.empty()) {
+    return;
+  }
+  Vector row(n_);
+  for (int64_t i = 0; i < mat.size(0); i++) {
+    real* x = mat.data() + i * n_;
+    rotate(x, row.data());
+    std::copy(row.data(), row.data() + n_, x);
+  }
+}
+
+real QuantMatrix::getNorm(int64_t i) const {
+  if (qnorm_) {
+    return npq_->get_centroids(0, norm_codes_[i])[0];
+  }
+  return 1.0;
+}
+
 void QuantMatrix::quantizeNorm(const Vector& norms) {
   assert(qnorm_);
   assert(norms.size() == m_);
@@ -44,40 +132,178 @@ void QuantMatrix::quantize(DenseMatrix&& mat) {
     mat.divideRow(norms);
     quantizeNorm(norms);
   }
+  rotateRows(mat);
   auto dataptr = mat.data();
   pq_->train(m_, dataptr);
   pq_->compute_codes(dataptr, codes_.data(), m_);
 }
 
+// Keeps a dense copy of the rows so that addVectorToRow can be used for
+// quantization-aware training. Gradients are applied both to the dense rows
+// and to the centroids they are currently assigned to.
+void QuantMatrix::enableTraining(DenseMatrix&& mat) {
+  assert(mat.size(0) == m_);
+  assert(mat.size(1) == n_);
+  shadow_ = std::unique_ptr<DenseMatrix>(
+      new DenseMatrix(std::forward<DenseMatrix>(mat)));
+}
+
+void QuantMatrix::disableTraining() {
+  shadow_.reset();
+}
+
+// Reassigns the codes of every row to the current codebooks.
+void QuantMatrix::requantize() {
+  if (!shadow_) {
+    throw std::runtime_error("Training is not enabled on quantized matrix.");
+  }
+  DenseMatrix mat(*shadow_);
+  if (qnorm_) {
+    Vector norms(m_);
+    mat.l2NormRow(norms);
+    mat.divideRow(norms);
+    npq_->compute_codes(norms.data(), norm_codes_.data(), m_);
+  }
+  rotateRows(mat);
+  pq_->compute_codes(mat.data(), codes_.data(), m_);
+}
+
 real QuantMatrix::dotRow(const Vector& vec, int64_t i) const {
   assert(i >= 0);
   assert(i < m_);
   assert(vec.size() == n_);
-  real norm = 1;
-  if (qnorm_) {
-    norm = npq_->get_centroids(0, norm_codes_[i])[0];
+  real norm = getNorm(i);
+  if (!rotation_.empty()) {
+    Vector rvec(n_);
+    rotate(vec.data(), rvec.data());
+    return pq_->mulcode(rvec, codes_.data(), i, norm);
   }
   return pq_->mulcode(vec, codes_.data(), i, norm);
 }
 
-void QuantMatrix::addVectorToRow(const Vector&, int64_t, real) {
-  throw std::runtime_error("Operation not permitted on quantized matrices.");
+void QuantMatrix::dotRows(const Vector& vec, Vector& out) const {
+  std::vector<real> buffer;
+  dotRows(vec, out, buffer);
+}
+
+// The buffer holds the rotated vector, then the dot table. Filling the table
+// costs as much as scoring as many rows as a sub-quantizer has centroids, so
+// smaller matrices score their rows directly.
+void QuantMatrix::dotRows(
+    const Vector& vec,
+    Vector& out,
+    std::vector<real>& buffer) const {
+  assert(vec.size() == n_);
+  assert(out.size() == m_);
+  const int64_t rsize = rotation_.empty() ? 0 : n_;
+  const int64_t tsize = m_ < pq_->get_ksub() ? 0 : pq_->get_dot_table_size();
+  if (buffer.size() < rsize + tsize) {
+    buffer.resize(rsize + tsize);
+  }
+  const real* x = vec.data();
+  if (rsize > 0) {
+    rotate(x, buffer.data());
+    x = buffer.data();
+  }
+  if (tsize == 0) {
+    for (int64_t i = 0; i < m_; i++) {
+      out[i] = pq_->mulcode(x, codes_.data(), i, getNorm(i));
+    }
+    return;
+  }
+  real* table = buffer.data() + rsize;
+  pq_->compute_dot_table(x, table);
+  for (int64_t i = 0; i < m_; i++) {
+    out[i] = pq_->mulcode_table(table, codes_.data(), i, getNorm(i));
+  }
+}
+
+// The codes are small enough to stay in cache, while a dot table per vector
+// saves the decoding of every row.
+void QuantMatrix::dotRowsBatch(
+    const std::vector<const Vector*>& vecs,
+    const std::vector<Vector*>& outs,
+    std::vector<real>& buffer) const {
+  assert(vecs.size() == outs.size());
+  for (size_t j = 0; j < vecs.size(); j++) {
+    dotRows(*vecs[j], *outs[j], buffer);
+  }
+}
+
+void QuantMatrix::addVectorToRow(const Vector& vec, int64_t i, real a) {
+  addVectorToRows(vec, std::vector<int32_t>(1, i), a);
+}
+
+void QuantMatrix::addVectorToRows(
+    const Vector& vec,
+    const std::vector<int32_t>& rows,
+    real a) {
+  if (!shadow_) {
+    throw std::runtime_error("Operation not permitted on quantized matrices.");
+  }
+  assert(vec.size() == n_);
+  Vector rvec(n_);
+  if (!rotation_.empty()) {
+    rotate(vec.data(), rvec.data());
+  } else {
+    std::copy(vec.data(), vec.data() + n_, rvec.data());
+  }
+  for (auto it = rows.cbegin(); it != rows.cend(); ++it) {
+    shadow_->addVectorToRow(vec, *it, a);
+    pq_->update_centroids(rvec, codes_.data(), *it, a * getNorm(*it));
+  }
 }
 
 void QuantMatrix::addRowToVector(Vector& x, int32_t i, real a) const {
-  real norm = 1;
-  if (qnorm_) {
-    norm = npq_->get_centroids(0, norm_codes_[i])[0];
+  real norm = getNorm(i);
+  if (!rotation_.empty()) {
+    Vector rx(n_);
+    rx.zero();
+    pq_->addcode(rx, codes_.data(), i, a * norm);
+    unrotate(rx.data(), x.data());
+    return;
   }
   pq_->addcode(x, codes_.data(), i, a * norm);
 }
 
 void QuantMatrix::addRowToVector(Vector& x, int32_t i) const {
-  real norm = 1;
-  if (qnorm_) {
-    norm = npq_->get_centroids(0, norm_codes_[i])[0];
+  addRowToVector(x, i, 1.0);
+}
+
+void QuantMatrix::addRowsToVector(
+    Vector& x,
+    const std::vector<int32_t>& rows) const {
+  if (rotation_.empty()) {
+    Matrix::addRowsToVector(x, rows);
+    return;
+  }
+  // Sum the rows in the rotated space and rotate back only once.
+  Vector rx(n_);
+  rx.zero();
+  for (auto it = rows.cbegin(); it != rows.cend(); ++it) {
+    pq_->addcode(rx, codes_.data(), *it, getNorm(*it));
   }
-  pq_->addcode(x, codes_.data(), i, norm);
+  unrotate(rx.data(), x.data());
+}
+
+bool QuantMatrix::isRotated() const {
+  return !rotation_.empty();
+}
+
+void QuantMatrix::rotate(const Vector& x, Vector& rx) const {
+  assert(x.size() == n_);
+  assert(rx.size() == n_);
+  if (rotation_.empty()) {
+    rx = x;
+    return;
+  }
+  rotate(x.data(), rx.data());
+}
+
+real QuantMatrix::dotRotatedRow(const Vector& rx, int64_t i) const {
+  assert(i >= 0);
+  assert(i < m_);
+  return pq_->mulcode(rx, codes_.data(), i, getNorm(i));
 }
 
 void QuantMatrix::save(std::ostream& out) const {
@@ -91,9 +317,18 @@ void QuantMatrix::save(std::ostream& out) const {
     out.write((char*)norm_codes_.data(), m_ * sizeof(uint8_t));
     npq_->save(out);
   }
+  bool rotated = !rotation_.empty();
+  out.write((char*)&rotated, sizeof(rotated));
+  if (rotated) {
+    out.write((char*)rotation_.data(), n_ * n_ * sizeof(real));
+  }
 }
 
 void QuantMatrix::load(std::istream& in) {
+  load(in, true);
+}
+
+void QuantMatrix::load(std::istream& in, bool hasRotation) {
   in.read((char*)&qnorm_, sizeof(qnorm_));
   in.read((char*)&m_, sizeof(m_));
   in.read((char*)&n_, sizeof(n_));
@@ -108,6 +343,15 @@ void QuantMatrix::load(std::istream& in) {
     npq_ = std::unique_ptr<ProductQuantizer>(new ProductQuantizer());
     npq_->load(in);
   }
+  rotation_.clear();
+  bool rotated = false;
+  if (hasRotation) {
+    in.read((char*)&rotated, sizeof(rotated));
+  }
+  if (rotated) {
+    rotation_.resize(n_ * n_);
+    in.read((char*)rotation_.data(), n_ * n_ * sizeof(real));
+  }
 }
 
 void QuantMatrix::dump(std::ostream&) const {
@@ -32,13 +32,21 @@ class QuantMatrix : public Matrix {
 
   std::vector<uint8_t> codes_;
   std::vector<uint8_t> norm_codes_;
+  std::vector<real> rotation_;
+  std::unique_ptr<DenseMatrix> shadow_;
 
   bool qnorm_;
   int32_t codesize_;
 
+  void initRotation();
+  void rotate(const real*, real*) const;
+  void unrotate(const real*, real*) const;
+  void rotateRows(DenseMatrix&) const;
+  real getNorm(int64_t) const;
+
  public:
   QuantMatrix();
-  QuantMatrix(DenseMatrix&&, int32_t, bool);
+  QuantMatrix(DenseMatrix&&, int32_t, bool, bool rotate = false);
   QuantMatrix(const QuantMatrix&) = delete;
   QuantMatrix(QuantMatrix&&) = delete;
   QuantMatrix& operator=(const QuantMatrix&) = delete;
@@ -47,13 +55,31 @@ class QuantMatrix : public Matrix {
 
   void quantizeNorm(const Vector&);
   void quantize(DenseMatrix&& mat);
+  void enableTraining(DenseMatrix&& mat);
+  void disableTraining();
+  void requantize();
 
   real dotRow(const Vector&, int64_t) const override;
+  void dotRows(const Vector&, Vector&) const override;
+  void dotRows(const Vector&, Vector&, std::vector<real>& buffer)
+      const override;
+  void dotRowsBatch(
+      const std::vector<const Vector*>&,
+      const std::vector<Vector*>&,
+      std::vector<real>& buffer) const override;
   void addVectorToRow(const Vector&, int64_t, real) override;
+  void addVectorToRows(const Vector&, const std::vector<int32_t>& rows, real)
+      override;
   void addRowToVector(Vector& x, int32_t i) const override;
   void addRowToVector(Vector& x, int32_t i, real a) const override;
+  void addRowsToVector(Vector& x, const std::vector<int32_t>& rows)
+      const override;
+  bool isRotated() const override;
+  void rotate(const Vector& x, Vector& rx) const override;
+  real dotRotatedRow(const Vector& rx, int64_t i) const override;
   void save(std::ostream&) const override;
   void load(std::istream&) override;
+  void load(std::istream&, bool hasRotation);
   void dump(std::ostream&) const override;
 };
 
@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "scalarquantmatrix.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "simd.h"
+#include "utils.h"
+
+namespace fasttext {
+
+namespace {
+
+real dotInt8(const int8_t* row, const real* x, int64_t n) {
+  real d = 0.0;
+  int64_t j = 0;
+#ifdef FASTTEXT_SIMD
+  __m256 acc = _mm256_setzero_ps();
+  for (; j + 8 <= n; j += 8) {
+    acc = _mm256_fmadd_ps(
+        simd::loadInt8x8(row + j), _mm256_loadu_ps(x + j), acc);
+  }
+  d = simd::horizontalSum(acc);
+#endif
+  for (; j < n; j++) {
+    d += real(row[j]) * x[j];
+  }
+  return d;
+}
+
+void addInt8(const int8_t* row, real a, real* x, int64_t n) {
+  int64_t j = 0;
+#ifdef FASTTEXT_SIMD
+  __m256 va = _mm256_set1_ps(a);
+  for (; j + 8 <= n; j += 8) {
+    __m256 r = _mm256_fmadd_ps(
+        va, simd::loadInt8x8(row + j), _mm256_loadu_ps(x + j));
+    _mm256_storeu_ps(x + j, r);
+  }
+#endif
+  for (; j < n; j++) {
+    x[j] += a * row[j];
+  }
+}
+
+real dotHalf(const uint16_t* row, const real* x, int64_t n) {
+  real d = 0.0;
+  int64_t j = 0;
+#ifdef FASTTEXT_SIMD
+  __m256 acc = _mm256_setzero_ps();
+  for (; j + 8 <= n; j += 8) {
+    acc = _mm256_fmadd_ps(
+        simd::loadHalf8(row + j), _mm256_loadu_ps(x + j), acc);
+  }
+  d = simd::horizontalSum(acc);
+#endif
+  for (; j < n; j++) {
+    d += utils::halfToFloat(row[j]) * x[j];
+  }
+  return d;
+}
+
+void addHalf(const uint16_t* row, real a, real* x, int64_t n) {
+  int64_t j = 0;
+#ifdef FASTTEXT_SIMD
+  __m256 va = _mm256_set1_ps(a);
+  for (; j + 8 <= n; j += 8) {
+    __m256 r = _mm256_fmadd_ps(
+        va, simd::loadHalf8(row + j), _mm256_loadu_ps(x + j));
+    _mm256_storeu_ps(x + j, r);
+  }
+#endif
+  for (; j < n; j++) {
+    x[j] += a * utils::halfToFloat(row[j]);
+  }
+}
+
+} // namespace
+
+ScalarQuantMatrix::ScalarQuantMatrix()
+    : Matrix(), type_(scalar_type::int8) {}
+
+ScalarQuantMatrix::ScalarQuantMatrix(const DenseMatrix& mat, scalar_type type)
+    : Matrix(mat.size(0), mat.size(1)), type_(type) {
+  if (type_ == scalar_type::int8) {
+    codes_.resize(m_ * n_);
+    scales_.resize(m_);
+  } else {
+    halfs_.resize(m_ * n_);
+  }
+  for (int64_t i = 0; i < m_; i++) {
+    quantizeRow(mat.data() + i * n_, i);
+  }
+}
+
+void ScalarQuantMatrix::quantizeRow(const real* x, int64_t i) {
+  if (type_ == scalar_type::fp16) {
+    uint16_t* row = halfs_.data() + i * n_;
+    for (int64_t j = 0; j < n_; j++) {
+      row[j] = utils::floatToHalf(x[j]);
+    }
+    return;
+  }
+  real maxabs = 0.0;
+  for (int64_t j = 0; j < n_; j++) {
+    maxabs = std::max(maxabs, std::abs(x[j]));
+  }
+  real scale = maxabs / 127;
+  scales_[i] = scale;
+  int8_t* row = codes_.data() + i * n_;
+  for (int64_t j = 0; j < n_; j++) {
+    real q = scale > 0 ? std::round(x[j] / scale) : 0;
+    row[j] = int8_t(std::max(real(-127), std::min(real(127), q)));
+  }
+}
+
+void ScalarQuantMatrix::decodeRow(int64_t i, real* x) const {
+  if (type_ == scalar_type::fp16) {
+    const uint16_t* row = halfs_.data() + i * n_;
+    for (int64_t j = 0; j < n_; j++) {
+      x[j] = utils::halfToFloat(row[j]);
+    }
+  } else {
+    const int8_t* row = codes_.data() + i * n_;
+    for (int64_t j = 0; j < n_; j++) {
+      x[j] = scales_[i] * row[j];
+    }
+  }
+}
+
+real ScalarQuantMatrix::dotRow(const Vector& vec, int64_t i) const {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(vec.size() == n_);
+  if (type_ == scalar_type::fp16) {
+    return dotHalf(halfs_.data() + i * n_, vec.data(), n_);
+  }
+  return scales_[i] * dotInt8(codes_.data() + i * n_, vec.data(), n_);
+}
+
+void ScalarQuantMatrix::addVectorToRow(const Vector& vec, int64_t i, real a) {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(vec.size() == n_);
+  Vector row(n_);
+  decodeRow(i, row.data());
+  row.addVector(vec, a);
+  quantizeRow(row.data(), i);
+}
+
+void ScalarQuantMatrix::addRowToVector(Vector& x, int32_t i) const {
+  addRowToVector(x, i, 1.0);
+}
+
+void ScalarQuantMatrix::addRowToVector(Vector& x, int32_t i, real a) const {
+  assert(i >= 0);
+  assert(i < m_);
+  assert(x.size() == n_);
+  if (type_ == scalar_type::fp16) {
+    addHalf(halfs_.data() + i * n_, a, x.data(), n_);
+    return;
+  }
+  addInt8(codes_.data() + i * n_, a * scales_[i], x.data(), n_);
+}
+
+void ScalarQuantMatrix::save(std::ostream& out) const {
+  out.write((char*)&type_, sizeof(type_));
+  out.write((char*)&m_, sizeof(m_));
+  out.write((char*)&n_, sizeof(n_));
+  if (type_ == scalar_type::fp16) {
+    out.write((char*)halfs_.data(), m_ * n_ * sizeof(uint16_t));
+  } else {
+    out.write((char*)scales_.data(), m_ * sizeof(real));
+    out.write((char*)codes_.data(), m_ * n_ * sizeof(int8_t));
+  }
+}
+
+void ScalarQuantMatrix::load(std::istream& in) {
+  in.read((char*)&type_, sizeof(type_));
+  in.read((char*)&m_, sizeof(m_));
+  in.read((char*)&n_, sizeof(n_));
+  codes_.clear();
+  halfs_.clear();
+  scales_.clear();
+  if (type_ == scalar_type::fp16) {
+    halfs_.resize(m_ * n_);
+    in.read((char*)halfs_.data(), m_ * n_ * sizeof(uint16_t));
+  } else if (type_ == scalar_type::int8) {
+    scales_.resize(m_);
+    codes_.resize(m_ * n_);
+    in.read((char*)scales_.data(), m_ * sizeof(real));
+    in.read((char*)codes_.data(), m_ * n_ * sizeof(int8_t));
+  } else {
+    throw std::invalid_argument("Unknown scalar quantization type.");
+  }
+}
+
+void ScalarQuantMatrix::dump(std::ostream& out) const {
+  out << m_ << " " << n_ << std::endl;
+  Vector row(n_);
+  for (int64_t i = 0; i < m_; i++) {
+    decodeRow(i, row.data());
+    for (int64_t j = 0; j < n_; j++) {
+      if (j > 0) {
+        out << " ";
+      }
+      out << row[j];
+    }
+    out << std::endl;
+  }
+}
+
+} // namespace fasttext
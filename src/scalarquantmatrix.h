@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "real.h"
+
+#include "densematrix.h"
+#include "matrix.h"
+#include "vector.h"
+
+namespace fasttext {
+
+enum class scalar_type : int8_t { int8 = 1, fp16 };
+
+class ScalarQuantMatrix : public Matrix {
+ protected:
+  scalar_type type_;
+  std::vector<int8_t> codes_;
+  std::vector<uint16_t> halfs_;
+  std::vector<real> scales_;
+
+  void quantizeRow(const real*, int64_t);
+  void decodeRow(int64_t, real*) const;
+
+ public:
+  ScalarQuantMatrix();
+  ScalarQuantMatrix(const DenseMatrix&, scalar_type);
+  ScalarQuantMatrix(const ScalarQuantMatrix&) = delete;
+  ScalarQuantMatrix(ScalarQuantMatrix&&) = delete;
+  ScalarQuantMatrix& operator=(const ScalarQuantMatrix&) = delete;
+  ScalarQuantMatrix& operator=(ScalarQuantMatrix&&) = delete;
+  virtual ~ScalarQuantMatrix() noexcept override = default;
+
+  real dotRow(const Vector&, int64_t) const override;
+  void addVectorToRow(const Vector&, int64_t, real) override;
+  void addRowToVector(Vector& x, int32_t i) const override;
+  void addRowToVector(Vector& x, int32_t i, real a) const override;
+  void save(std::ostream&) const override;
+  void load(std::istream&) override;
+  void dump(std::ostream&) const override;
+};
+
+} // namespace fasttext
@@ -0,0 +1,352 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "sectionstream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "compression.h"
+#include "utils.h"
+
+namespace fasttext {
+
+namespace {
+
+constexpr int64_t kSectionBufferSize = 1 << 20;
+
+// Compressed sections are a sequence of chunks made of
+//   uint32 raw size, uint32 payload size, payload
+// where the payload is a sequence of blocks made of
+//   uint32 block size, block
+// each block holding at most kBlockSize bytes of the (shuffled) chunk.
+constexpr int64_t kChunkSize = 1 << 18;
+constexpr int64_t kBlockSize = 1 << 16;
+constexpr int32_t kShuffleStride = 4;
+constexpr int64_t kChunkHeaderSize = 2 * sizeof(uint32_t);
+
+// Calls f(i) for i in [0, n) from up to `thread` threads, and rethrows the
+// first exception raised.
+void parallelFor(
+    int64_t n,
+    int32_t thread,
+    const std::function<void(int64_t)>& f) {
+  std::vector<std::exception_ptr> errors(n);
+  auto run = [&](int64_t first, int64_t step) {
+    for (int64_t i = first; i < n; i += step) {
+      try {
+        f(i);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+  int64_t nthreads = std::min<int64_t>(thread, n);
+  if (nthreads > 1) {
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < nthreads; i++) {
+      threads.push_back(std::thread(run, i, nthreads));
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  } else {
+    // webassembly can't instantiate `std::thread`
+    run(0, 1);
+  }
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+void compressChunk(
+    const char* data,
+    int64_t size,
+    int32_t flags,
+    std::vector<char>& out) {
+  std::vector<char> shuffled;
+  if (flags & kShuffledSection) {
+    shuffled.resize(size);
+    compression::shuffle(data, size, kShuffleStride, shuffled.data());
+    data = shuffled.data();
+  }
+  int64_t nblocks = (size + kBlockSize - 1) / kBlockSize;
+  out.resize(
+      kChunkHeaderSize +
+      nblocks * (sizeof(uint32_t) + compression::compressBound(kBlockSize)));
+  int64_t pos = kChunkHeaderSize;
+  for (int64_t begin = 0; begin < size; begin += kBlockSize) {
+    uint32_t blockSize = compression::compressBlock(
+        data + begin,
+        std::min(kBlockSize, size - begin),
+        out.data() + pos + sizeof(uint32_t));
+    std::memcpy(out.data() + pos, &blockSize, sizeof(uint32_t));
+    pos += sizeof(uint32_t) + blockSize;
+  }
+  uint32_t header[2] = {uint32_t(size), uint32_t(pos - kChunkHeaderSize)};
+  std::memcpy(out.data(), header, kChunkHeaderSize);
+  out.resize(pos);
+}
+
+void decompressChunk(
+    const std::vector<char>& payload,
+    int64_t size,
+    int32_t flags,
+    char* out) {
+  std::vector<char> shuffled;
+  char* data = out;
+  if (flags & kShuffledSection) {
+    shuffled.resize(size);
+    data = shuffled.data();
+  }
+  const char* ip = payload.data();
+  const char* end = ip + payload.size();
+  for (int64_t begin = 0; begin < size; begin += kBlockSize) {
+    uint32_t blockSize;
+    if (end - ip < int64_t(sizeof(uint32_t))) {
+      throw std::invalid_argument("Corrupted compressed model section.");
+    }
+    std::memcpy(&blockSize, ip, sizeof(uint32_t));
+    ip += sizeof(uint32_t);
+    if (blockSize > end - ip) {
+      throw std::invalid_argument("Corrupted compressed model section.");
+    }
+    compression::decompressBlock(
+        ip, blockSize, data + begin, std::min(kBlockSize, size - begin));
+    ip += blockSize;
+  }
+  if (ip != end) {
+    throw std::invalid_argument("Corrupted compressed model section.");
+  }
+  if (flags & kShuffledSection) {
+    compression::unshuffle(data, size, kShuffleStride, out);
+  }
+}
+
+} // namespace
+
+Section::Section(section_id id)
+    : id(id), flags(0), offset(0), size(0), checksum(0) {}
+
+void Section::save(std::ostream& out) const {
+  out.write((char*)&id, sizeof(section_id));
+  out.write((char*)&flags, sizeof(int32_t));
+  out.write((char*)&offset, sizeof(int64_t));
+  out.write((char*)&size, sizeof(int64_t));
+  out.write((char*)&checksum, sizeof(uint32_t));
+}
+
+void Section::load(std::istream& in) {
+  in.read((char*)&id, sizeof(section_id));
+  in.read((char*)&flags, sizeof(int32_t));
+  in.read((char*)&offset, sizeof(int64_t));
+  in.read((char*)&size, sizeof(int64_t));
+  in.read((char*)&checksum, sizeof(uint32_t));
+}
+
+SectionWriter::SectionWriter(std::ostream& out, int32_t flags, int32_t thread)
+    : out_(out),
+      flags_(flags),
+      thread_(std::max(thread, 1)),
+      buffer_(
+          (flags & kCompressedSection) ? thread_ * kChunkSize
+                                       : kSectionBufferSize),
+      size_(0),
+      checksum_(0) {
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+void SectionWriter::write(const char* data, int64_t size) {
+  checksum_ = utils::crc32c(checksum_, data, size);
+  size_ += size;
+  out_.write(data, size);
+}
+
+void SectionWriter::writeChunks(const char* data, int64_t size) {
+  int64_t nchunks = (size + kChunkSize - 1) / kChunkSize;
+  std::vector<std::vector<char>> chunks(nchunks);
+  parallelFor(nchunks, thread_, [&](int64_t i) {
+    int64_t begin = i * kChunkSize;
+    compressChunk(
+        data + begin,
+        std::min(kChunkSize, size - begin),
+        flags_,
+        chunks[i]);
+  });
+  for (const auto& chunk : chunks) {
+    write(chunk.data(), chunk.size());
+  }
+}
+
+bool SectionWriter::flushBuffer() {
+  if (flags_ & kCompressedSection) {
+    writeChunks(pbase(), pptr() - pbase());
+  } else {
+    write(pbase(), pptr() - pbase());
+  }
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+  return bool(out_);
+}
+
+SectionWriter::int_type SectionWriter::overflow(int_type c) {
+  if (!flushBuffer()) {
+    return traits_type::eof();
+  }
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+// Large writes, such as matrices, bypass the buffer of uncompressed
+// sections.
+std::streamsize SectionWriter::xsputn(const char* s, std::streamsize n) {
+  std::streamsize done = 0;
+  while (done < n) {
+    if (pptr() == epptr() && !flushBuffer()) {
+      return done;
+    }
+    if (!(flags_ & kCompressedSection) && pptr() == pbase() &&
+        n - done >= epptr() - pbase()) {
+      write(s + done, n - done);
+      return out_ ? n : done;
+    }
+    int64_t size = std::min<int64_t>(epptr() - pptr(), n - done);
+    std::memcpy(pptr(), s + done, size);
+    pbump(size);
+    done += size;
+  }
+  return done;
+}
+
+int SectionWriter::sync() {
+  return flushBuffer() ? 0 : -1;
+}
+
+void SectionWriter::finish(Section& section) {
+  if (!flushBuffer()) {
+    throw std::runtime_error("Error while writing the model.");
+  }
+  section.size = size_;
+  section.checksum = checksum_;
+}
+
+SectionReader::SectionReader(
+    std::istream& in,
+    const Section& section,
+    bool verify,
+    int32_t thread)
+    : in_(in),
+      section_(section),
+      verify_(verify),
+      thread_(std::max(thread, 1)),
+      buffer_(
+          (section.flags & kCompressedSection) ? thread_ * kChunkSize
+                                               : kSectionBufferSize),
+      remaining_(section.size),
+      checksum_(0) {
+  setg(buffer_.data(), buffer_.data(), buffer_.data());
+}
+
+int64_t SectionReader::read(char* data, int64_t size) {
+  size = std::min(size, remaining_);
+  in_.read(data, size);
+  size = in_.gcount();
+  remaining_ -= size;
+  if (verify_) {
+    checksum_ = utils::crc32c(checksum_, data, size);
+  }
+  return size;
+}
+
+// Reads up to one chunk per thread and decompresses them in parallel into
+// the buffer. Returns the number of decompressed bytes.
+int64_t SectionReader::readChunks() {
+  std::vector<std::vector<char>> payloads;
+  std::vector<int64_t> offsets(1, 0);
+  while (payloads.size() < thread_ && remaining_ > 0) {
+    uint32_t header[2];
+    if (read((char*)header, kChunkHeaderSize) != kChunkHeaderSize ||
+        header[0] > kChunkSize) {
+      throw std::invalid_argument("Corrupted compressed model section.");
+    }
+    payloads.emplace_back(std::min<int64_t>(header[1], remaining_));
+    if (read(payloads.back().data(), payloads.back().size()) != header[1]) {
+      throw std::invalid_argument("Model file is truncated.");
+    }
+    offsets.push_back(offsets.back() + header[0]);
+  }
+  parallelFor(payloads.size(), thread_, [&](int64_t i) {
+    decompressChunk(
+        payloads[i],
+        offsets[i + 1] - offsets[i],
+        section_.flags,
+        buffer_.data() + offsets[i]);
+  });
+  return offsets.back();
+}
+
+SectionReader::int_type SectionReader::underflow() {
+  int64_t size = (section_.flags & kCompressedSection)
+      ? readChunks()
+      : read(buffer_.data(), buffer_.size());
+  setg(buffer_.data(), buffer_.data(), buffer_.data() + size);
+  if (size == 0) {
+    return traits_type::eof();
+  }
+  return traits_type::to_int_type(*gptr());
+}
+
+// Large reads, such as matrices, go directly to the destination for
+// uncompressed sections.
+std::streamsize SectionReader::xsgetn(char* s, std::streamsize n) {
+  std::streamsize done = 0;
+  while (done < n) {
+    if (gptr() == egptr()) {
+      if (!(section_.flags & kCompressedSection) &&
+          n - done >= int64_t(buffer_.size())) {
+        return done + read(s + done, n - done);
+      }
+      if (traits_type::eq_int_type(underflow(), traits_type::eof())) {
+        return done;
+      }
+    }
+    int64_t size = std::min<int64_t>(egptr() - gptr(), n - done);
+    std::memcpy(s + done, gptr(), size);
+    gbump(size);
+    done += size;
+  }
+  return done;
+}
+
+void SectionReader::finish() {
+  while (remaining_ > 0) {
+    if (read(buffer_.data(), buffer_.size()) == 0) {
+      break;
+    }
+  }
+  setg(buffer_.data(), buffer_.data(), buffer_.data());
+  if (remaining_ > 0) {
+    throw std::invalid_argument("Model file is truncated.");
+  }
+  if (verify_ && checksum_ != section_.checksum) {
+    throw std::invalid_argument(
+        "Checksum mismatch in model section " +
+        std::to_string(int32_t(section_.id)) + ".");
+  }
+}
+
+} // namespace fasttext
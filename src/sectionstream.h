@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+namespace fasttext {
+
+enum class section_id : int32_t {
+  args = 1,
+  dictionary,
+  input,
+  output,
+  checkpoint
+};
+
+// Section flags. Compressed sections are stored as chunks compressed
+// independently, shuffled ones have the bytes of 4-byte values regrouped
+// before compression.
+constexpr int32_t kCompressedSection = 1;
+constexpr int32_t kShuffledSection = 2;
+
+// Entry of the table of contents at the beginning of a model file.
+// Offsets are absolute positions in the file.
+struct Section {
+  section_id id;
+  int32_t flags;
+  int64_t offset;
+  int64_t size;
+  uint32_t checksum;
+
+  explicit Section(section_id);
+  void save(std::ostream&) const;
+  void load(std::istream&);
+};
+
+// Streams the payload of a section to `out` through a bounded buffer,
+// computing its size and checksum on the way. With kCompressedSection, the
+// buffer holds one chunk per thread, compressed in parallel.
+class SectionWriter : public std::streambuf {
+ protected:
+  std::ostream& out_;
+  int32_t flags_;
+  int32_t thread_;
+  std::vector<char> buffer_;
+  int64_t size_;
+  uint32_t checksum_;
+
+  void write(const char*, int64_t);
+  void writeChunks(const char*, int64_t);
+  bool flushBuffer();
+  int_type overflow(int_type) override;
+  std::streamsize xsputn(const char*, std::streamsize) override;
+  int sync() override;
+
+ public:
+  SectionWriter(std::ostream&, int32_t flags, int32_t thread);
+  SectionWriter(const SectionWriter&) = delete;
+  SectionWriter& operator=(const SectionWriter&) = delete;
+
+  void finish(Section&);
+};
+
+// Reads the payload of a section from `in`, which must be positioned at its
+// offset. finish() consumes the rest of the section and, if requested,
+// checks the checksum.
+class SectionReader : public std::streambuf {
+ protected:
+  std::istream& in_;
+  const Section& section_;
+  bool verify_;
+  int32_t thread_;
+  std::vector<char> buffer_;
+  int64_t remaining_;
+  uint32_t checksum_;
+
+  int64_t read(char*, int64_t);
+  int64_t readChunks();
+  int_type underflow() override;
+  std::streamsize xsgetn(char*, std::streamsize) override;
+
+ public:
+  SectionReader(
+      std::istream&,
+      const Section&,
+      bool verify,
+      int32_t thread);
+  SectionReader(const SectionReader&) = delete;
+  SectionReader& operator=(const SectionReader&) = delete;
+
+  void finish();
+};
+
+} // namespace fasttext
@@ -0,0 +1,591 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "server.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace fasttext {
+
+namespace {
+
+constexpr int64_t kReadSize = 1 << 16;
+constexpr int64_t kMaxLineSize = 1 << 20;
+// requests of a connection read but not answered yet
+constexpr int64_t kMaxPendingRequests = 256;
+// requests of all the connections waiting for a worker
+constexpr size_t kMaxQueuedRequests = 4096;
+// seconds a client may leave its responses unread before being dropped
+constexpr int kSendTimeout = 10;
+// type of the predict requests, the first of types_
+constexpr int32_t kPredict = 0;
+
+#ifndef _WIN32
+bool sendAll(int socket, const std::string& data) {
+  const char* p = data.data();
+  int64_t size = data.size();
+  while (size > 0) {
+    ssize_t n = ::send(socket, p, size, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false; // the client left, or doesn't read
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+#endif
+
+std::string formatPredictions(
+    const std::vector<std::pair<real, std::string>>& predictions) {
+  std::ostringstream out;
+  for (size_t i = 0; i < predictions.size(); i++) {
+    out << (i > 0 ? " " : "") << predictions[i].second << ' '
+        << predictions[i].first;
+  }
+  return out.str();
+}
+
+} // namespace
+
+Server::Histogram::Histogram() {
+  for (int32_t i = 0; i < kBuckets; i++) {
+    counts_[i] = 0;
+  }
+}
+
+void Server::Histogram::add(int64_t micros) {
+  int32_t bucket = 0;
+  while (bucket + 1 < kBuckets && (int64_t(1) << (bucket + 1)) <= micros) {
+    bucket++;
+  }
+  counts_[bucket]++;
+}
+
+int64_t Server::Histogram::count() const {
+  int64_t count = 0;
+  for (int32_t i = 0; i < kBuckets; i++) {
+    count += counts_[i];
+  }
+  return count;
+}
+
+// Returns the upper bound of the bucket holding the percentile.
+int64_t Server::Histogram::percentile(double p) const {
+  int64_t rank = p * count();
+  int64_t seen = 0;
+  for (int32_t i = 0; i < kBuckets; i++) {
+    seen += counts_[i];
+    if (seen > rank) {
+      return int64_t(1) << (i + 1);
+    }
+  }
+  return int64_t(1) << kBuckets;
+}
+
+Server::Server(
+    std::shared_ptr<ModelHolder> models,
+    int32_t thread,
+    int32_t batch)
+    : models_(models),
+      thread_(std::max(thread, 1)),
+      batch_(std::max(batch, 1)),
+      stopped_(false),
+      listener_(-1),
+      reloadable_(false),
+      readers_(0),
+      writers_(0),
+      types_({"predict",
+              "vector",
+              "sentence",
+              "nn",
+              "stats",
+              "reload",
+              "other"}) {
+  for (size_t i = 0; i < types_.size(); i++) {
+    latencies_.emplace_back(new Histogram());
+  }
+}
+
+int32_t Server::getType(const std::string& line) const {
+  std::string type = line.substr(0, line.find(' '));
+  for (int32_t i = 0; i + 1 < types_.size(); i++) {
+    if (types_[i] == type) {
+      return i;
+    }
+  }
+  return types_.size() - 1;
+}
+
+std::string Server::stats() const {
+  std::ostringstream out;
+  for (size_t i = 0; i < types_.size(); i++) {
+    int64_t count = latencies_[i]->count();
+    if (count == 0) {
+      continue;
+    }
+    if (out.tellp() > 0) {
+      out << '\t';
+    }
+    out << types_[i] << " count " << count << " p50 "
+        << latencies_[i]->percentile(0.5) << " p90 "
+        << latencies_[i]->percentile(0.9) << " p99 "
+        << latencies_[i]->percentile(0.99);
+  }
+  return out.str();
+}
+
+std::string Server::handle(
+    const std::string& line,
+    FastText::Context& context) {
+  // the end of line is a token of the text
+  std::istringstream in(line + "\n");
+  std::ostringstream out;
+  std::string type;
+  in >> type;
+  // the model of the whole request, even if another one is swapped in
+  std::shared_ptr<const FastText> fasttext = models_->get();
+  try {
+    if (type == "predict") {
+      int32_t k;
+      real threshold;
+      if (!(in >> k >> threshold)) {
+        throw std::invalid_argument("usage: predict <k> <threshold> <text>");
+      }
+      std::vector<std::pair<real, std::string>> predictions;
+      fasttext->predictLine(in, predictions, k, threshold, context);
+      out << formatPredictions(predictions);
+    } else if (type == "vector") {
+      std::string word;
+      if (!(in >> word)) {
+        throw std::invalid_argument("usage: vector <word>");
+      }
+      Vector vec(fasttext->getDimension());
+      fasttext->getWordVector(vec, word, context);
+      out << vec;
+    } else if (type == "sentence") {
+      Vector vec(fasttext->getDimension());
+      fasttext->getSentenceVector(in, vec, context);
+      out << vec;
+    } else if (type == "nn") {
+      int32_t k;
+      std::string word;
+      if (!(in >> k >> word)) {
+        throw std::invalid_argument("usage: nn <k> <word>");
+      }
+      auto neighbors = fasttext->getNN(word, k, context);
+      for (size_t i = 0; i < neighbors.size(); i++) {
+        out << (i > 0 ? " " : "") << neighbors[i].second << ' '
+            << neighbors[i].first;
+      }
+    } else if (type == "stats") {
+      out << stats();
+    } else if (type == "reload") {
+      if (!reloadable_) {
+        throw std::invalid_argument(
+            "reload is only accepted on a unix: socket");
+      }
+      return reload(line);
+    } else {
+      throw std::invalid_argument("unknown request " + type);
+    }
+  } catch (const std::exception& e) {
+    return std::string("error ") + e.what();
+  }
+  return out.str();
+}
+
+std::string Server::reload(const std::string& line) {
+  std::istringstream in(line);
+  std::string type, filename;
+  if (!(in >> type >> filename)) {
+    return "error usage: reload <model>";
+  }
+  try {
+    models_->reload(filename);
+  } catch (const std::exception& e) {
+    return std::string("error ") + e.what();
+  }
+  return "ok";
+}
+
+void Server::work() {
+  std::vector<FastText::Context> contexts(batch_);
+  std::vector<Request> batch;
+  while (true) {
+    batch.clear();
+    {
+      std::unique_lock<std::mutex> lock(requestsMutex_);
+      requestsCondition_.wait(
+          lock, [&]() { return stopped_ || !requests_.empty(); });
+      if (requests_.empty()) {
+        return;
+      }
+      // a run of predict requests at the front of the queue is batched
+      do {
+        batch.push_back(std::move(requests_.front()));
+        requests_.pop_front();
+      } while (batch.size() < batch_ && !requests_.empty() &&
+               getType(batch.back().line) == kPredict &&
+               getType(requests_.front().line) == kPredict);
+      roomCondition_.notify_all();
+    }
+    if (batch.size() == 1) {
+      respond(batch[0], handle(batch[0].line, contexts[0]));
+    } else {
+      predict(batch, contexts);
+    }
+  }
+}
+
+// Answers a batch of predict requests. The requests which fail, if any, are
+// answered one by one to get their own errors.
+void Server::predict(
+    const std::vector<Request>& batch,
+    std::vector<FastText::Context>& contexts) {
+  std::shared_ptr<const FastText> fasttext = models_->get();
+  std::vector<const Request*> valid;
+  std::vector<std::string> texts;
+  std::vector<int32_t> k;
+  std::vector<real> threshold;
+  for (const auto& request : batch) {
+    std::istringstream in(request.line);
+    std::string type, text;
+    int32_t requestK;
+    real requestThreshold;
+    if (!(in >> type >> requestK >> requestThreshold)) {
+      respond(request, handle(request.line, contexts[0]));
+      continue;
+    }
+    std::getline(in, text);
+    valid.push_back(&request);
+    // the end of line is a token of the text
+    texts.push_back(text + "\n");
+    k.push_back(requestK);
+    threshold.push_back(requestThreshold);
+  }
+  std::vector<std::vector<std::pair<real, std::string>>> predictions;
+  try {
+    fasttext->predictLines(texts, k, threshold, predictions, contexts);
+  } catch (const std::exception&) {
+    for (const Request* request : valid) {
+      respond(*request, handle(request->line, contexts[0]));
+    }
+    return;
+  }
+  for (size_t i = 0; i < valid.size(); i++) {
+    respond(*valid[i], formatPredictions(predictions[i]));
+  }
+}
+
+#ifdef _WIN32
+
+void Server::listen(const std::string&) {
+  throw std::runtime_error("The server is not supported on Windows!");
+}
+
+void Server::read(std::shared_ptr<Connection>) {}
+
+bool Server::reserve(std::shared_ptr<Connection>, Request&) {
+  return false;
+}
+
+bool Server::enqueue(std::shared_ptr<Connection>, std::string&) {
+  return false;
+}
+
+void Server::write(std::shared_ptr<Connection>) {}
+
+void Server::respond(const Request&, const std::string&) {}
+
+void Server::serve(const std::string& address) {
+  listen(address);
+}
+
+void Server::stop() {}
+
+#else
+
+void Server::listen(const std::string& address) {
+  if (address.compare(0, 5, "unix:") == 0) {
+    std::string path = address.substr(5);
+    struct sockaddr_un local;
+    std::memset(&local, 0, sizeof(local));
+    local.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(local.sun_path)) {
+      throw std::invalid_argument("Invalid socket path " + path + "!");
+    }
+    std::strcpy(local.sun_path, path.c_str());
+    unlink(path.c_str());
+    listener_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener_ < 0 ||
+        bind(listener_, (struct sockaddr*)&local, sizeof(local)) != 0 ||
+        ::listen(listener_, SOMAXCONN) != 0) {
+      throw std::runtime_error("Cannot listen on " + address + "!");
+    }
+    reloadable_ = true;
+    return;
+  }
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    throw std::invalid_argument(
+        "Address " + address + " is not of the form host:port or unix:path!");
+  }
+  std::string host = address.substr(0, colon);
+  std::string port = address.substr(colon + 1);
+  struct addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  struct addrinfo* info;
+  if (getaddrinfo(
+          host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info) !=
+      0) {
+    throw std::invalid_argument("Cannot resolve " + address + "!");
+  }
+  listener_ = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+  int one = 1;
+  setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  bool bound = listener_ >= 0 &&
+      bind(listener_, info->ai_addr, info->ai_addrlen) == 0 &&
+      ::listen(listener_, SOMAXCONN) == 0;
+  freeaddrinfo(info);
+  if (!bound) {
+    throw std::runtime_error("Cannot listen on " + address + "!");
+  }
+}
+
+void Server::read(std::shared_ptr<Connection> connection) {
+  std::vector<char> buffer(kReadSize);
+  std::string line;
+  // the rest of a line too long is skipped
+  bool skipping = false;
+  bool reading = true;
+  ssize_t n;
+  while (reading &&
+         (n = recv(connection->socket, buffer.data(), buffer.size(), 0)) >
+             0) {
+    for (ssize_t i = 0; reading && i < n; i++) {
+      if (buffer[i] != '\n') {
+        if (!skipping) {
+          line.push_back(buffer[i]);
+        }
+        if (int64_t(line.size()) > kMaxLineSize) {
+          Request request;
+          reading = reserve(connection, request);
+          if (reading) {
+            respond(
+                request,
+                "error request longer than " + std::to_string(kMaxLineSize) +
+                    " bytes");
+          }
+          line.clear();
+          skipping = true;
+        }
+        continue;
+      }
+      if (skipping) {
+        skipping = false;
+        continue;
+      }
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      reading = enqueue(connection, line);
+      line.clear();
+    }
+  }
+  // the socket is closed once the pending responses are sent
+  shutdown(connection->socket, SHUT_RD);
+  {
+    std::lock_guard<std::mutex> lock(connection->mutex);
+    connection->reading = false;
+    connection->condition.notify_all();
+  }
+  std::lock_guard<std::mutex> lock(connectionsMutex_);
+  readers_--;
+  connectionsCondition_.notify_all();
+}
+
+// Gives the next id of the connection to a request once the connection has
+// room for it, and returns false if the connection must not be read
+// anymore.
+bool Server::reserve(std::shared_ptr<Connection> connection, Request& request) {
+  request.connection = connection;
+  request.start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(connection->mutex);
+  connection->condition.wait(lock, [&]() {
+    return stopped_ || connection->broken ||
+        connection->nextRequest - connection->nextResponse <
+        kMaxPendingRequests;
+  });
+  if (stopped_ || connection->broken) {
+    return false;
+  }
+  request.id = connection->nextRequest++;
+  return true;
+}
+
+// Queues a request line once the queue has room for it.
+bool Server::enqueue(
+    std::shared_ptr<Connection> connection,
+    std::string& line) {
+  Request request;
+  if (!reserve(connection, request)) {
+    return false;
+  }
+  request.line = std::move(line);
+  std::unique_lock<std::mutex> lock(requestsMutex_);
+  roomCondition_.wait(lock, [&]() {
+    return stopped_ || requests_.size() < kMaxQueuedRequests;
+  });
+  if (stopped_) {
+    lock.unlock();
+    respond(request, "error the server is stopping");
+    return false;
+  }
+  requests_.push_back(std::move(request));
+  requestsCondition_.notify_one();
+  return true;
+}
+
+// Sends the responses of a connection in order, until its reader stopped
+// and every request read got its response.
+void Server::write(std::shared_ptr<Connection> connection) {
+  std::unique_lock<std::mutex> lock(connection->mutex);
+  while (true) {
+    connection->condition.wait(lock, [&]() {
+      return connection->responses.count(connection->nextResponse) ||
+          (!connection->reading &&
+           connection->nextResponse == connection->nextRequest);
+    });
+    auto it = connection->responses.find(connection->nextResponse);
+    if (it == connection->responses.end()) {
+      break;
+    }
+    std::string response = std::move(it->second);
+    connection->responses.erase(it);
+    if (!connection->broken) {
+      lock.unlock();
+      bool sent = sendAll(connection->socket, response);
+      lock.lock();
+      connection->broken = !sent;
+    }
+    connection->nextResponse++;
+    // the reader may wait for room
+    connection->condition.notify_all();
+  }
+  lock.unlock();
+  std::lock_guard<std::mutex> connectionsLock(connectionsMutex_);
+  writers_--;
+  connectionsCondition_.notify_all();
+}
+
+void Server::respond(const Request& request, const std::string& response) {
+  Connection& connection = *request.connection;
+  {
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    connection.responses[request.id] = response + "\n";
+    connection.condition.notify_all();
+  }
+  int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - request.start)
+                       .count();
+  latencies_[getType(request.line)]->add(micros);
+}
+
+void Server::serve(const std::string& address) {
+  listen(address);
+  std::vector<std::thread> workers;
+  for (int32_t i = 0; i < thread_; i++) {
+    workers.push_back(std::thread([this]() { work(); }));
+  }
+  while (!stopped_) {
+    int socket = accept(listener_, nullptr, nullptr);
+    if (socket < 0) {
+      continue;
+    }
+    struct timeval timeout;
+    timeout.tv_sec = kSendTimeout;
+    timeout.tv_usec = 0;
+    setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    auto connection = std::shared_ptr<Connection>(
+        new Connection(socket), [](Connection* connection) {
+          close(connection->socket);
+          delete connection;
+        });
+    {
+      std::lock_guard<std::mutex> lock(connectionsMutex_);
+      connections_.erase(
+          std::remove_if(
+              connections_.begin(),
+              connections_.end(),
+              [](const std::weak_ptr<Connection>& c) { return c.expired(); }),
+          connections_.end());
+      connections_.push_back(connection);
+      readers_++;
+      writers_++;
+    }
+    std::thread([this, connection]() { read(connection); }).detach();
+    std::thread([this, connection]() { write(connection); }).detach();
+  }
+  close(listener_);
+  {
+    std::unique_lock<std::mutex> lock(connectionsMutex_);
+    connectionsCondition_.wait(lock, [&]() { return readers_ == 0; });
+  }
+  {
+    std::lock_guard<std::mutex> lock(requestsMutex_);
+    requestsCondition_.notify_all();
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  std::unique_lock<std::mutex> lock(connectionsMutex_);
+  connectionsCondition_.wait(lock, [&]() { return writers_ == 0; });
+}
+
+// Stops accepting connections and reading requests. serve() returns once
+// the queued requests are answered, or their clients dropped.
+void Server::stop() {
+  stopped_ = true;
+  if (listener_ >= 0) {
+    shutdown(listener_, SHUT_RDWR);
+  }
+  {
+    std::lock_guard<std::mutex> lock(requestsMutex_);
+    roomCondition_.notify_all();
+  }
+  std::lock_guard<std::mutex> lock(connectionsMutex_);
+  for (const auto& connection : connections_) {
+    if (auto c = connection.lock()) {
+      shutdown(c->socket, SHUT_RD);
+      std::lock_guard<std::mutex> connectionLock(c->mutex);
+      c->condition.notify_all();
+    }
+  }
+}
+
+#endif
+
+} // namespace fasttext
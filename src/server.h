@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fasttext.h"
+#include "modelholder.h"
+
+namespace fasttext {
+
+// Answers requests on a loaded model over a Unix socket ("unix:<path>") or
+// TCP ("host:port"), with one request and one response per line:
+//   predict <k> <threshold> <text>  labels and probabilities
+//   vector <word>                   word vector
+//   sentence <text>                 sentence vector
+//   nn <k> <word>                   nearest neighbors and similarities
+//   stats                           latency percentiles in microseconds
+//   reload <model>                  load a model and swap it in
+// reload loads any file the server can read, so it is only accepted on a
+// Unix socket, whose file permissions select the clients allowed to
+// swap the model. A TCP listener may be reachable from other hosts.
+// Failed requests get "error <message>". Requests are queued and handled
+// by a pool of threads. A thread takes up to batch consecutive predict
+// requests at once and scores their hidden vectors against the output
+// matrix in one pass, which reads the matrix once for the batch instead of
+// once per request (a hierarchical softmax still walks its tree for each).
+// Other requests are taken one at a time, and a thread never waits for a
+// batch to fill. The responses of a connection are
+// sent in the order of its requests by a writer thread of the connection,
+// so that a client which doesn't read its responses never blocks a worker.
+// A connection stops being read while it has too many unanswered requests
+// or the queue is full, and a client leaving a response unread for too
+// long is dropped. Request lines longer than the maximum get an error. A
+// reload is a request like the others: its worker loads the model while
+// the other workers keep answering with the previous one, see ModelHolder
+// for which requests see which model.
+class Server {
+ protected:
+  struct Connection {
+    int socket;
+    std::mutex mutex;
+    std::condition_variable condition;
+    int64_t nextRequest;
+    int64_t nextResponse;
+    // responses not sent yet, by request
+    std::map<int64_t, std::string> responses;
+    bool reading;
+    // the client stopped receiving, responses are dropped
+    bool broken;
+
+    explicit Connection(int socket)
+        : socket(socket),
+          nextRequest(0),
+          nextResponse(0),
+          reading(true),
+          broken(false) {}
+  };
+
+  struct Request {
+    std::shared_ptr<Connection> connection;
+    int64_t id;
+    std::string line;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  // Counts of latencies by power of two of microseconds.
+  class Histogram {
+   public:
+    static const int32_t kBuckets = 32;
+
+    Histogram();
+    void add(int64_t micros);
+    int64_t count() const;
+    int64_t percentile(double p) const;
+
+   protected:
+    std::atomic<int64_t> counts_[kBuckets];
+  };
+
+  std::shared_ptr<ModelHolder> models_;
+  int32_t thread_;
+  size_t batch_;
+  std::deque<Request> requests_;
+  std::mutex requestsMutex_;
+  std::condition_variable requestsCondition_;
+  // signaled when a request leaves the queue
+  std::condition_variable roomCondition_;
+  std::atomic<bool> stopped_;
+  int listener_;
+  // listening on a Unix socket, reload requests are accepted
+  bool reloadable_;
+  std::vector<std::weak_ptr<Connection>> connections_;
+  int32_t readers_;
+  int32_t writers_;
+  std::mutex connectionsMutex_;
+  std::condition_variable connectionsCondition_;
+  std::vector<std::string> types_;
+  std::vector<std::unique_ptr<Histogram>> latencies_;
+
+  void listen(const std::string& address);
+  void read(std::shared_ptr<Connection> connection);
+  bool reserve(std::shared_ptr<Connection> connection, Request& request);
+  bool enqueue(std::shared_ptr<Connection> connection, std::string& line);
+  void write(std::shared_ptr<Connection> connection);
+  void work();
+  void predict(
+      const std::vector<Request>& batch,
+      std::vector<FastText::Context>& contexts);
+  void respond(const Request& request, const std::string& response);
+  std::string reload(const std::string& line);
+  int32_t getType(const std::string& line) const;
+  std::string stats() const;
+
+ public:
+  Server(
+      std::shared_ptr<ModelHolder> models,
+      int32_t thread,
+      int32_t batch);
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  // Answers one request line, using the inference buffers of the calling
+  // thread.
+  std::string handle(const std::string& line, FastText::Context& context);
+  // Serves until stop() is called.
+  void serve(const std::string& address);
+  void stop();
+};
+
+} // namespace fasttext
@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "real.h"
+
+// Kernels shared by the matrices storing their rows in fewer bits. Callers
+// guard their vectorized loops with FASTTEXT_SIMD and finish the last
+// elements with a scalar loop.
+#if defined(__AVX2__) && defined(__F16C__) && defined(__FMA__)
+#include <immintrin.h>
+#define FASTTEXT_SIMD
+#endif
+
+namespace fasttext {
+
+namespace simd {
+
+#ifdef FASTTEXT_SIMD
+inline real horizontalSum(__m256 acc) {
+  float tmp[8];
+  _mm256_storeu_ps(tmp, acc);
+  return tmp[0] + tmp[1] + tmp[2] + tmp[3] + tmp[4] + tmp[5] + tmp[6] +
+      tmp[7];
+}
+
+// Loads 8 IEEE half precision values.
+inline __m256 loadHalf8(const uint16_t* p) {
+  return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)p));
+}
+
+// Loads 8 bfloat16 values, which are the upper halves of floats.
+inline __m256 loadBFloat8(const uint16_t* p) {
+  __m128i h = _mm_loadu_si128((const __m128i*)p);
+  return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+}
+
+// Loads 8 signed bytes.
+inline __m256 loadInt8x8(const int8_t* p) {
+  __m128i b = _mm_loadl_epi64((const __m128i*)p);
+  return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(b));
+}
+#endif
+
+} // namespace simd
+
+} // namespace fasttext
@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "streamqueue.h"
+
+#include <cerrno>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace fasttext {
+
+namespace {
+
+constexpr int64_t kStreamBlockSize = 1 << 16;
+// milliseconds between two checks of close() while the input is idle
+constexpr int kPollTimeout = 100;
+
+} // namespace
+
+StreamQueue::StreamQueue(int fd, size_t capacity)
+    : fd_(fd),
+      capacity_(capacity),
+      eof_(false),
+      closed_(false),
+      ended_(false),
+      done_(false) {}
+
+// Waits for the input to be readable. Returns false once closed.
+bool StreamQueue::waitInput() const {
+#ifndef _WIN32
+  struct pollfd p;
+  p.fd = fd_;
+  p.events = POLLIN;
+  while (!closed_) {
+    p.revents = 0;
+    int n = poll(&p, 1, kPollTimeout);
+    if (n > 0 || (n < 0 && errno != EINTR)) {
+      // a poll error is left for the read to report
+      return true;
+    }
+  }
+#endif
+  return !closed_;
+}
+
+// Reads at least kStreamBlockSize bytes, up to the end of a line, unless the
+// input ends first. The last line of the input gets a newline if it lacks
+// one. Returns false at the end of the input or once closed.
+bool StreamQueue::readBlock(std::string& block) {
+  std::vector<char> buffer(kStreamBlockSize);
+  while (!eof_ &&
+         (int64_t(pending_.size()) < kStreamBlockSize ||
+          pending_.find('\n', kStreamBlockSize - 1) == std::string::npos)) {
+    if (!waitInput()) {
+      return false;
+    }
+#ifdef _WIN32
+    int n = _read(fd_, buffer.data(), buffer.size());
+#else
+    ssize_t n = ::read(fd_, buffer.data(), buffer.size());
+#endif
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      eof_ = true;
+    } else {
+      pending_.append(buffer.data(), n);
+    }
+  }
+  if (pending_.empty()) {
+    return false;
+  }
+  size_t end = pending_.size();
+  if (!eof_) {
+    end = pending_.find('\n', kStreamBlockSize - 1) + 1;
+  }
+  block.assign(pending_, 0, end);
+  pending_.erase(0, end);
+  if (block.back() != '\n') {
+    block.push_back('\n');
+  }
+  return true;
+}
+
+void StreamQueue::run() {
+  std::string block;
+  while (readBlock(block)) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    notFull_.wait(
+        lock, [&]() { return closed_ || blocks_.size() < capacity_; });
+    if (closed_) {
+      break;
+    }
+    blocks_.push_back(std::move(block));
+    notEmpty_.notify_one();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  ended_ = true;
+  notEmpty_.notify_all();
+}
+
+bool StreamQueue::pop(
+    std::string& block,
+    std::chrono::milliseconds timeout) {
+  if (capacity_ == 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!closed_ && readBlock(block)) {
+      return true;
+    }
+    ended_ = true;
+    done_ = true;
+    return false;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!notEmpty_.wait_for(lock, timeout, [&]() {
+        return closed_ || ended_ || !blocks_.empty();
+      })) {
+    return false;
+  }
+  if (closed_ || blocks_.empty()) {
+    done_ = true;
+    return false;
+  }
+  block = std::move(blocks_.front());
+  blocks_.pop_front();
+  notFull_.notify_one();
+  return true;
+}
+
+void StreamQueue::close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  closed_ = true;
+  notEmpty_.notify_all();
+  notFull_.notify_all();
+}
+
+bool StreamQueue::done() const {
+  return done_;
+}
+
+bool StreamQueue::ended() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ended_;
+}
+
+} // namespace fasttext
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace fasttext {
+
+// Bounded queue of blocks of whole lines read from a file descriptor which
+// can't be seeked, such as a pipe. run() fills the queue from a reader thread
+// and pop() hands the blocks to the training threads. With a capacity of 0,
+// there is no reader thread and pop() reads the blocks itself. The reader
+// polls the input, so that run() returns soon after close() even if no more
+// input comes, and the reader thread can be joined (except on Windows, where
+// it stays blocked in its read until the next input).
+class StreamQueue {
+ protected:
+  int fd_;
+  size_t capacity_;
+  // input read after the last newline handed out
+  std::string pending_;
+  bool eof_;
+  std::deque<std::string> blocks_;
+  std::mutex mutex_;
+  std::condition_variable notEmpty_;
+  std::condition_variable notFull_;
+  std::atomic<bool> closed_;
+  bool ended_;
+  std::atomic<bool> done_;
+
+  bool waitInput() const;
+  bool readBlock(std::string&);
+
+ public:
+  StreamQueue(int fd, size_t capacity);
+  StreamQueue(const StreamQueue&) = delete;
+  StreamQueue& operator=(const StreamQueue&) = delete;
+
+  void run();
+  // Waits at most timeout for a block, which it reads itself with a capacity
+  // of 0. Returns false if none came, including once done().
+  bool pop(std::string&, std::chrono::milliseconds timeout);
+  void close();
+  // true once the input is exhausted and all its blocks were handed out
+  bool done() const;
+  // true once the reader reached the end of the input
+  bool ended();
+};
+
+} // namespace fasttext
@@ -8,8 +8,22 @@
 
 #include "utils.h"
 
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <ios>
+#include <thread>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
 
 namespace fasttext {
 
@@ -32,6 +46,32 @@ double getDuration(
       .count();
 }
 
+int64_t getResidentMemory() {
+#if defined(__linux__)
+  std::FILE* statm = std::fopen("/proc/self/statm", "r");
+  if (statm) {
+    long pages = 0;
+    long resident = 0;
+    int n = std::fscanf(statm, "%ld %ld", &pages, &resident);
+    std::fclose(statm);
+    if (n == 2) {
+      return int64_t(resident) * sysconf(_SC_PAGESIZE);
+    }
+  }
+#endif
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+    return usage.ru_maxrss;
+#else
+    return int64_t(usage.ru_maxrss) * 1024;
+#endif
+  }
+#endif
+  return 0;
+}
+
 ClockPrint::ClockPrint(int32_t duration) : duration_(duration) {}
 
 std::ostream& operator<<(std::ostream& out, const ClockPrint& me) {
@@ -48,6 +88,285 @@ bool compareFirstLess(const std::pair<double, double>& l, const double& r) {
   return l.first < r;
 }
 
+// IEEE 754 binary16 conversions, rounding to nearest even.
+uint16_t floatToHalf(float value) {
+  uint32_t x;
+  std::memcpy(&x, &value, sizeof(x));
+  uint16_t sign = (x >> 16) & 0x8000;
+  uint32_t exponent = (x >> 23) & 0xff;
+  uint32_t mantissa = x & 0x7fffff;
+
+  if (exponent == 0xff) { // inf or nan
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  }
+  int32_t e = int32_t(exponent) - 127 + 15;
+  if (e >= 0x1f) { // overflow
+    return sign | 0x7c00;
+  }
+  if (e <= 0) { // subnormal or zero
+    if (e < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000;
+    uint32_t shift = 14 - e;
+    uint32_t half = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half & 1))) {
+      half++;
+    }
+    return sign | half;
+  }
+  uint32_t half = (uint32_t(e) << 10) | (mantissa >> 13);
+  uint32_t rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+    half++; // may carry into the exponent, which is the correct rounding
+  }
+  return sign | half;
+}
+
+float halfToFloat(uint16_t value) {
+  uint32_t sign = uint32_t(value & 0x8000) << 16;
+  uint32_t exponent = (value >> 10) & 0x1f;
+  uint32_t mantissa = value & 0x3ff;
+  uint32_t x;
+  if (exponent == 0x1f) {
+    x = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    x = sign;
+  } else { // subnormal: normalize the mantissa
+    exponent = 127 - 15 + 1;
+    while ((mantissa & 0x400) == 0) {
+      mantissa <<= 1;
+      exponent--;
+    }
+    x = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  }
+  float result;
+  std::memcpy(&result, &x, sizeof(result));
+  return result;
+}
+
+// bfloat16 keeps the upper half of a float, rounding to nearest even.
+uint16_t floatToBFloat16(float value) {
+  uint32_t x;
+  std::memcpy(&x, &value, sizeof(x));
+  if ((x & 0x7fffffff) > 0x7f800000) { // nan
+    return (x >> 16) | 0x40;
+  }
+  x += 0x7fff + ((x >> 16) & 1);
+  return x >> 16;
+}
+
+float bfloat16ToFloat(uint16_t value) {
+  uint32_t x = uint32_t(value) << 16;
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+// Short decimal numbers, such as the ones written by saveVectors, are
+// converted exactly with a single float operation. Other inputs fall back
+// to strtof.
+const char* parseReal(const char* begin, const char* end, real& value) {
+  static const float kPowers[] = {
+      1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+  const char* p = begin;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  uint64_t mantissa = 0;
+  int32_t digits = 0;
+  int32_t exponent = 0;
+  const char* start = p;
+  while (p < end && *p >= '0' && *p <= '9') {
+    mantissa = mantissa * 10 + (*p - '0');
+    digits++;
+    p++;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits++;
+      exponent--;
+      p++;
+    }
+  }
+  if (p == start || (p == start + 1 && *start == '.')) {
+    return nullptr;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool negativeExponent = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      negativeExponent = *q == '-';
+      q++;
+    }
+    int32_t e = 0;
+    const char* digitsStart = q;
+    while (q < end && *q >= '0' && *q <= '9' && e < 100000) {
+      e = e * 10 + (*q - '0');
+      q++;
+    }
+    if (q != digitsStart) {
+      exponent += negativeExponent ? -e : e;
+      p = q;
+    }
+  }
+  if (digits <= 7 && exponent >= -10 && exponent <= 10) {
+    float f = float(mantissa);
+    f = (exponent < 0) ? f / kPowers[-exponent] : f * kPowers[exponent];
+    value = negative ? -f : f;
+    return p;
+  }
+  std::string number(begin, p);
+  value = std::strtof(number.c_str(), nullptr);
+  return p;
+}
+
+// Values of magnitude in [1e-4, 1e5) are rounded to 5 significant digits
+// with integer arithmetic. Values close to a rounding tie, and other
+// magnitudes, go through snprintf.
+int32_t formatReal(real value, char* out) {
+  static const double kPowers[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8};
+  double a = std::abs(double(value));
+  if (!(a >= 1e-4 && a < 99999.5)) {
+    return std::snprintf(out, 32, "%.5g", value);
+  }
+  int32_t e = 4;
+  while (e > -4 && a < kPowers[e + 4] * 1e-4) {
+    e--;
+  }
+  double t = a * kPowers[4 - e];
+  double frac = t - std::floor(t);
+  if (std::abs(frac - 0.5) < 1e-6) {
+    return std::snprintf(out, 32, "%.5g", value);
+  }
+  int64_t m = int64_t(std::floor(t + 0.5));
+  if (m >= 100000) {
+    m /= 10;
+    e++;
+    if (e > 4) {
+      return std::snprintf(out, 32, "%.5g", value);
+    }
+  }
+  char digits[5];
+  for (int32_t i = 4; i >= 0; i--) {
+    digits[i] = '0' + (m % 10);
+    m /= 10;
+  }
+  int32_t ndigits = 5;
+  int32_t minDigits = (e >= 0) ? e + 1 : 1;
+  while (ndigits > minDigits && digits[ndigits - 1] == '0') {
+    ndigits--;
+  }
+  char* p = out;
+  if (value < 0) {
+    *p++ = '-';
+  }
+  if (e >= 0) {
+    for (int32_t i = 0; i <= e; i++) {
+      *p++ = digits[i];
+    }
+    if (ndigits > e + 1) {
+      *p++ = '.';
+      for (int32_t i = e + 1; i < ndigits; i++) {
+        *p++ = digits[i];
+      }
+    }
+  } else {
+    *p++ = '0';
+    *p++ = '.';
+    for (int32_t i = 0; i < -e - 1; i++) {
+      *p++ = '0';
+    }
+    for (int32_t i = 0; i < ndigits; i++) {
+      *p++ = digits[i];
+    }
+  }
+  *p = '\0';
+  return p - out;
+}
+
+constexpr int64_t kChunkSize = 1 << 16;
+
+void parallelChunks(
+    int64_t size,
+    unsigned int thread,
+    int32_t seed,
+    const std::function<void(int64_t, int64_t, std::minstd_rand&)>& f) {
+  int64_t nchunks = (size + kChunkSize - 1) / kChunkSize;
+  auto run = [&](int64_t first, int64_t last) {
+    for (int64_t chunk = first; chunk < last; chunk++) {
+      std::seed_seq seq{uint32_t(seed), uint32_t(chunk)};
+      std::minstd_rand rng(seq);
+      int64_t begin = chunk * kChunkSize;
+      f(begin, std::min(begin + kChunkSize, size), rng);
+    }
+  };
+  if (thread > 1) {
+    std::vector<std::thread> threads;
+    for (int64_t i = 0; i < thread; i++) {
+      threads.push_back(std::thread(
+          run, nchunks * i / thread, nchunks * (i + 1) / thread));
+    }
+    for (int32_t i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+  } else {
+    // webassembly can't instantiate `std::thread`
+    run(0, nchunks);
+  }
+}
+
+#if defined(__SSE4_2__)
+uint32_t crc32c(uint32_t crc, const char* data, int64_t size) {
+  uint64_t c = ~crc;
+  int64_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    c = _mm_crc32_u64(c, word);
+  }
+  for (; i < size; i++) {
+    c = _mm_crc32_u8(uint32_t(c), uint8_t(data[i]));
+  }
+  return ~uint32_t(c);
+}
+#else
+namespace {
+
+struct Crc32cTable {
+  uint32_t t[256];
+  Crc32cTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int j = 0; j < 8; j++) {
+        c = (c >> 1) ^ ((c & 1) ? 0x82f63b78 : 0);
+      }
+      t[i] = c;
+    }
+  }
+};
+
+} // namespace
+
+uint32_t crc32c(uint32_t crc, const char* data, int64_t size) {
+  static const Crc32cTable table;
+  uint32_t c = ~crc;
+  for (int64_t i = 0; i < size; i++) {
+    c = table.t[(c ^ uint8_t(data[i])) & 0xff] ^ (c >> 8);
+  }
+  return ~c;
+}
+#endif
+
 } // namespace utils
 
 } // namespace fasttext
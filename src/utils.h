@@ -12,8 +12,15 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdint>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <new>
 #include <ostream>
+#include <random>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #if defined(__clang__) || defined(__GNUC__)
@@ -56,6 +63,10 @@ double getDuration(
     const std::chrono::steady_clock::time_point& start,
     const std::chrono::steady_clock::time_point& end);
 
+// Resident memory of the process in bytes, or its peak where the current
+// value is not available, or 0 if unknown.
+int64_t getResidentMemory();
+
 class ClockPrint {
  public:
   explicit ClockPrint(int32_t duration);
@@ -67,6 +78,59 @@ class ClockPrint {
 
 bool compareFirstLess(const std::pair<double, double>& l, const double& r);
 
+uint16_t floatToHalf(float value);
+
+float halfToFloat(uint16_t value);
+
+uint16_t floatToBFloat16(float value);
+
+float bfloat16ToFloat(uint16_t value);
+
+// Parses a decimal floating point number starting at `begin`. Returns the
+// position after the number, or nullptr if there is no number there.
+const char* parseReal(const char* begin, const char* end, real& value);
+
+// Writes `value` as printf("%.5g") does, which is the format used for
+// vectors, and returns the number of characters written. `out` must hold
+// at least 32 characters.
+int32_t formatReal(real value, char* out);
+
+// Extends the CRC-32C (Castagnoli) checksum `crc` with `size` bytes.
+// Start from 0.
+uint32_t crc32c(uint32_t crc, const char* data, int64_t size);
+
+// Splits [0, size) in fixed size chunks and calls f(begin, end, rng) on each
+// of them from `thread` threads. Every chunk has its own generator seeded
+// from (seed, chunk), so the result does not depend on the number of threads.
+void parallelChunks(
+    int64_t size,
+    unsigned int thread,
+    int32_t seed,
+    const std::function<void(int64_t, int64_t, std::minstd_rand&)>& f);
+
+// Allocator leaving values uninitialized on resize, so that memory pages
+// are only mapped when first written, by the thread that writes them.
+template <typename T>
+class DefaultInitAllocator : public std::allocator<T> {
+ public:
+  template <typename U>
+  struct rebind {
+    using other = DefaultInitAllocator<U>;
+  };
+
+  using std::allocator<T>::allocator;
+
+  template <typename U>
+  void construct(U* p) noexcept(
+      std::is_nothrow_default_constructible<U>::value) {
+    ::new (static_cast<void*>(p)) U;
+  }
+  template <typename U, typename... Args>
+  void construct(U* p, Args&&... args) {
+    ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+  }
+};
+
 } // namespace utils
 
 } // namespace fasttext
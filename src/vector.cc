@@ -68,9 +68,16 @@ void Vector::addRow(const Matrix& A, int64_t i) {
 void Vector::mul(const Matrix& A, const Vector& vec) {
   assert(A.size(0) == size());
   assert(A.size(1) == vec.size());
-  for (int64_t i = 0; i < size(); i++) {
-    data_[i] = A.dotRow(vec, i);
-  }
+  A.dotRows(vec, *this);
+}
+
+void Vector::mul(
+    const Matrix& A,
+    const Vector& vec,
+    std::vector<real>& buffer) {
+  assert(A.size(0) == size());
+  assert(A.size(1) == vec.size());
+  A.dotRows(vec, *this, buffer);
 }
 
 int64_t Vector::argmax() {
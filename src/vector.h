@@ -53,6 +53,7 @@ class Vector {
   void addRow(const Matrix&, int64_t);
   void addRow(const Matrix&, int64_t, real);
   void mul(const Matrix&, const Vector&);
+  void mul(const Matrix&, const Vector&, std::vector<real>& buffer);
   int64_t argmax();
 };
 
@@ -228,7 +228,7 @@ EMSCRIPTEN_BINDINGS(fasttext) {
       .function(
           "getNN",
           select_overload<std::vector<std::pair<real, std::string>>(
-              const std::string& word, int32_t k)>(&FastText::getNN))
+              const std::string& word, int32_t k) const>(&FastText::getNN))
       .function("getAnalogies", &FastText::getAnalogies)
       .function("getWordId", &FastText::getWordId)
       .function("getSubwordId", &FastText::getSubwordId)